@@ -0,0 +1,106 @@
+#include <avr/pgmspace.h>
+#include "hd44780.h"
+
+
+const uint8_t hd44780_row_offsets[4] = { 0x00, 0x40, 0x14, 0x54 };
+
+
+void hd44780_send(hd44780_t *h, bool rs_mode, uint8_t value) {
+  h->send(h, rs_mode, value);
+}
+
+
+/*
+ * Computes the DDRAM address counter after a data write or a cursor
+ * shift, moving right (increment) or left.
+ */
+static uint8_t hd44780_next_addr(const hd44780_t *h, uint8_t addr, bool right) {
+  if (addr == LCD_ADDR_UNKNOWN) {
+    return addr;
+  }
+  if (h->function & LCD_2LINE) {
+    if (right) {
+      addr = (addr == 0x27) ? 0x40 : (addr == 0x67) ? 0x00 : addr + 1;
+    } else {
+      addr = (addr == 0x40) ? 0x27 : (addr == 0x00) ? 0x67 : addr - 1;
+    }
+  } else {
+    if (right) {
+      addr = (addr == 0x4F) ? 0x00 : addr + 1;
+    } else {
+      addr = (addr == 0x00) ? 0x4F : addr - 1;
+    }
+  }
+  return addr;
+}
+
+
+void hd44780_track(hd44780_t *h, bool rs_mode, uint8_t value) {
+  if (rs_mode == LCD_DATA) {
+    h->addr = hd44780_next_addr(h, h->addr, h->mode & LCD_ENTRYLEFT);
+  } else if (value & LCD_SETDDRAMADDR) {
+    h->addr = value & ~LCD_SETDDRAMADDR;
+  } else if (value & LCD_SETCGRAMADDR) {
+    h->addr = LCD_ADDR_UNKNOWN;
+  } else if ((value & 0xF0) == LCD_CURSORSHIFT && !(value & LCD_DISPLAYMOVE)) {
+    h->addr = hd44780_next_addr(h, h->addr, value & LCD_MOVERIGHT);
+  } else if (value <= (LCD_RETURNHOME | LCD_CLEARDISPLAY)) {
+    h->addr = 0x00;
+  }
+}
+
+
+void hd44780_display(hd44780_t *h, uint8_t bits, bool on) {
+  if (on) {
+    h->params |= bits;
+  } else {
+    h->params &= ~bits;
+  }
+  h->send(h, LCD_COMMAND, LCD_DISPLAYCONTROL | h->params);
+}
+
+
+void hd44780_entry(hd44780_t *h, uint8_t bits, bool on) {
+  if (on) {
+    h->mode |= bits;
+  } else {
+    h->mode &= ~bits;
+  }
+  h->send(h, LCD_COMMAND, LCD_ENTRYMODESET | h->mode);
+}
+
+
+void hd44780_shift(hd44780_t *h, uint8_t bits) {
+  h->send(h, LCD_COMMAND, LCD_CURSORSHIFT | bits);
+}
+
+
+void hd44780_create_char(hd44780_t *h, uint8_t location, const uint8_t charmap[8]) {
+  h->send(h, LCD_COMMAND, LCD_SETCGRAMADDR | ((location & 0x07) << 3));
+  for (uint8_t i = 0; i < 8; i++) {
+    h->send(h, LCD_DATA, charmap[i]);
+  }
+}
+
+
+void hd44780_move_cursor(hd44780_t *h, uint8_t col, uint8_t row) {
+  const uint8_t addr = col + hd44780_row_offsets[row & 0x03];
+
+  if (addr != h->addr) {
+    h->send(h, LCD_COMMAND, LCD_SETDDRAMADDR | addr);
+  }
+}
+
+
+void hd44780_print(hd44780_t *h, const char *string) {
+  for (; *string; string++) {
+    h->send(h, LCD_DATA, *string);
+  }
+}
+
+
+void hd44780_print_P(hd44780_t *h, const char *string) {
+  for (char ch; (ch = pgm_read_byte(string)); string++) {
+    h->send(h, LCD_DATA, ch);
+  }
+}
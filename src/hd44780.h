@@ -0,0 +1,149 @@
+/** @file hd44780.h
+ *  @brief HD44780 protocol core shared by the LCD drivers.
+ *
+ *  Holds the instruction set and the controller state (function set,
+ *  display control, entry mode and address counter), and builds every
+ *  command, whatever the bus the display is connected to. The bus is a
+ *  transport: the function that delivers one byte to the controller.
+ *  Transports are the parallel 4-bit and 8-bit buses (hd44780_par.h)
+ *  and the PCF8574 I2C expander (lcd_i2c.h).
+ */
+
+#ifndef HD44780_H
+#define HD44780_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//Main instructions (page 24)
+#define LCD_CLEARDISPLAY   0x01
+
+#define LCD_RETURNHOME     0x02
+
+#define LCD_ENTRYMODESET   0x04
+  #define LCD_ENTRYRIGHT          0x00
+  #define LCD_ENTRYLEFT           0x02
+  #define LCD_AUTOSCROLL_ON       0x01
+  #define LCD_AUTOSCROLL_OFF      0x00
+  #define LCD_ENTRYSHIFTINCREMENT LCD_AUTOSCROLL_ON
+  #define LCD_ENTRYSHIFTDECREMENT LCD_AUTOSCROLL_OFF
+
+#define LCD_DISPLAYCONTROL 0x08
+  #define LCD_DISPLAYON  0x04
+  #define LCD_DISPLAYOFF 0x00
+  #define LCD_CURSORON   0x02
+  #define LCD_CURSOROFF  0x00
+  #define LCD_BLINKON    0x01
+  #define LCD_BLINKOFF   0x00
+
+#define LCD_CURSORSHIFT    0x10
+  #define LCD_DISPLAYMOVE 0x08
+  #define LCD_CURSORMOVE  0x00
+  #define LCD_MOVERIGHT   0x04
+  #define LCD_MOVELEFT    0x00
+
+#define LCD_FUNCTIONSET    0x20
+  #define LCD_8BITMODE  0x10
+  #define LCD_4BITMODE  0x00
+  #define LCD_2LINE     0x08
+  #define LCD_1LINE     0x00
+  #define LCD_5x10DOTS  0x04
+  #define LCD_5x8DOTS   0x00
+
+#define LCD_SETCGRAMADDR   0x40
+#define LCD_SETDDRAMADDR   0x80
+
+/** Value of `addr` when the DDRAM address counter is not known */
+#define LCD_ADDR_UNKNOWN   0xFF
+
+#define LCD_COMMAND false
+#define LCD_DATA    true
+
+/** DDRAM address of the first column of each row (20x4 style layout) */
+extern const uint8_t hd44780_row_offsets[4];
+
+typedef struct hd44780 hd44780_t;
+
+/**
+ * @brief A transport delivers a DATA or COMMAND byte to the controller.
+ *
+ * @details It is responsible for the bus timings and must call
+ * hd44780_track() for every byte it accepts.
+ */
+typedef void (*hd44780_transport_t)(hd44780_t *h, bool rs_mode, uint8_t value);
+
+/**
+ * @brief Controller state, embedded in the object of each driver.
+ */
+struct hd44780 {
+  hd44780_transport_t send;
+  uint8_t function;   /**< LCD_FUNCTIONSET bits */
+  uint8_t params;     /**< LCD_DISPLAYCONTROL bits */
+  uint8_t mode;       /**< LCD_ENTRYMODESET bits */
+  uint8_t addr;       /**< DDRAM address counter as the controller will see it */
+};
+
+
+/**
+ * @brief Sends a DATA or COMMAND byte through the transport.
+ */
+void hd44780_send(hd44780_t *h, bool rs_mode, uint8_t value);
+
+
+/**
+ * @brief Updates the tracked address counter after a byte is sent.
+ *
+ * @details Data writes move it following the entry mode and cursor
+ * shifts in their direction. In 2-line mode the counter jumps between
+ * 0x27 and 0x40 and wraps from 0x67 to 0x00; in 1-line mode it wraps at
+ * 0x4F. CGRAM accesses make it unknown.
+ */
+void hd44780_track(hd44780_t *h, bool rs_mode, uint8_t value);
+
+
+/**
+ * @brief Sets or clears LCD_DISPLAYCONTROL bits (display, cursor, blink).
+ */
+void hd44780_display(hd44780_t *h, uint8_t bits, bool on);
+
+
+/**
+ * @brief Sets or clears LCD_ENTRYMODESET bits (direction, autoscroll).
+ */
+void hd44780_entry(hd44780_t *h, uint8_t bits, bool on);
+
+
+/**
+ * @brief Moves the cursor or the display one position.
+ *
+ * @param bits LCD_DISPLAYMOVE or LCD_CURSORMOVE, and LCD_MOVERIGHT or LCD_MOVELEFT
+ */
+void hd44780_shift(hd44780_t *h, uint8_t bits);
+
+
+/**
+ * @brief Defines one of the 8 custom characters (5x8px). The address
+ * counter is left in CGRAM: the cursor must be moved afterwards.
+ */
+void hd44780_create_char(hd44780_t *h, uint8_t location, const uint8_t charmap[8]);
+
+
+/**
+ * @brief Moves the cursor. Nothing is sent if the address counter
+ * already holds the address.
+ */
+void hd44780_move_cursor(hd44780_t *h, uint8_t col, uint8_t row);
+
+
+/**
+ * @brief Sends a string stored in SRAM.
+ */
+void hd44780_print(hd44780_t *h, const char *string);
+
+
+/**
+ * @brief Sends a string stored in flash (PSTR or PROGMEM).
+ */
+void hd44780_print_P(hd44780_t *h, const char *string);
+
+#endif
@@ -0,0 +1,230 @@
+//Source: https://github.com/aostanin/avr-hd44780
+
+#include <avr/io.h>
+#include <stddef.h>
+#include <util/delay.h>
+#include "hd44780_par.h"
+#include "hd44780_par_private.h"
+
+
+#define PORT(x) (*(x))
+#define DDR(x)  (*(x-1))   // consider DDRy = PORTy - 1
+#define PIN(x)  (*(x-2))   // consider PINy = PORTy - 2
+
+
+/*
+ * Pulse the enable pin so the LCD latches the data bus, then leave the
+ * instruction time unless the busy flag is polled or the queue paces it.
+ * @param p The LCD object
+ */
+static void hd44780_par_pulse_enable(hd44780_par_t *p) {
+  //Enable pulse
+  PORT(p->port) &= ~p->en;
+  PORT(p->port) |= p->en;
+  PORT(p->port) &= ~p->en;
+
+  if (!p->rw && !p->queue)
+    _delay_us(50); //Es pot provar de baixar
+}
+
+
+/*
+ * Send a nibble-sized message to the LCD (4-bit bus).
+ * @param p The LCD object where the message must be adressed
+ * @param nibble The 4-bit message to be sent
+ */
+void hd44780_par_write_nibble(hd44780_par_t *p, uint8_t nibble) {
+  PORT(p->port) = (PORT(p->port) & 0xf0) | (nibble & 0x0f);
+  hd44780_par_pulse_enable(p);
+}
+
+
+/*
+ * Send a whole byte to the LCD in a single transfer (8-bit bus).
+ * @param p The LCD object where the message must be adressed
+ * @param value The byte to be sent
+ */
+void hd44780_par_write_byte(hd44780_par_t *p, uint8_t value) {
+  PORT(p->data) = value;
+  hd44780_par_pulse_enable(p);
+}
+
+
+/*
+ * Select the data or instruction register.
+ * @param p The LCD object
+ * @param rs_mode LCD_COMMAND or LCD_DATA
+ */
+void hd44780_par_rs(hd44780_par_t *p, bool rs_mode) {
+  if (rs_mode) {
+    PORT(p->port) |= p->rs;
+  } else {
+    PORT(p->port) &= ~p->rs;
+  }
+}
+
+
+/*
+ * Wait until the LCD is not busy by polling its busy flag.
+ * Only when the RW pin is wired; otherwise the fixed delays are used.
+ * The busy flag is LCD D7: data port bit 7 on a 8-bit bus, or port
+ * bit 3 during the first of the two enable pulses of a 4-bit read.
+ * @param p The LCD object
+ */
+static void hd44780_par_wait_ready(hd44780_par_t *p) {
+  const bool bus8 = p->hd.function & LCD_8BITMODE;
+  const uint8_t pins = bus8 ? 0xff : 0x0f;
+  const uint8_t bf = bus8 ? 0x80 : 0x08;
+  bool busy;
+
+  if (!p->rw)
+    return;
+
+  DDR(p->data) &= ~pins;             // data pins as inputs
+  PORT(p->data) &= ~pins;            // no pull-ups
+  PORT(p->port) &= ~p->rs;           // read instruction register
+  PORT(p->port) |= p->rw;
+  do {
+    PORT(p->port) |= p->en;
+    _delay_us(1);                   // data valid 360ns after enable rises
+    busy = PIN(p->data) & bf;
+    PORT(p->port) &= ~p->en;
+
+    if (!bus8) {
+      // second nibble (address counter low bits) is discarded
+      PORT(p->port) |= p->en;
+      _delay_us(1);
+      PORT(p->port) &= ~p->en;
+    }
+  } while (busy);
+  PORT(p->port) &= ~p->rw;
+  DDR(p->data) |= pins;
+}
+
+
+/*
+ * Transport of the 4-bit bus: the byte is split into two nibble-sized
+ * messages. With the RW pin wired, it first waits for the busy flag to
+ * clear instead of sleeping a fixed time after each nibble.
+ */
+void hd44780_par_send4(hd44780_t *h, bool rs_mode, uint8_t message) {
+  hd44780_par_t *p = (hd44780_par_t *)h;
+
+  hd44780_par_wait_ready(p);
+  hd44780_par_rs(p, rs_mode);
+  hd44780_par_write_nibble(p, message >> 4);
+  hd44780_par_write_nibble(p, message);
+  hd44780_track(h, rs_mode, message);
+}
+
+
+/*
+ * Transport of the 8-bit bus: one transfer per byte.
+ */
+void hd44780_par_send8(hd44780_t *h, bool rs_mode, uint8_t message) {
+  hd44780_par_t *p = (hd44780_par_t *)h;
+
+  hd44780_par_wait_ready(p);
+  hd44780_par_rs(p, rs_mode);
+  hd44780_par_write_byte(p, message);
+  hd44780_track(h, rs_mode, message);
+}
+
+
+void hd44780_par_wait_slow(hd44780_par_t *p) {
+  if (!p->rw && !p->queue)
+    _delay_ms(2);   //Atention! (with RW, next byte waits for it)
+}
+
+
+/*
+ * Steps of the asynchronous bind. The sequence is according to the
+ * Hitachi HD44780 datasheet (pages 45 and 46) to init the LCD into 8 or
+ * 4 bit mode.
+ */
+enum {
+  BIND_POWER,    // wait for the LCD to become ready, 1st 8-bit set
+  BIND_8BIT_2,   // 2nd time, min 4.1ms later
+  BIND_8BIT_3,   // 3rd time, min 4.1ms later
+  BIND_MODE,     // bus mode and params, min 100us later
+  BIND_DONE
+};
+
+
+hd44780_par_t hd44780_par_start(volatile uint8_t *port, uint8_t rs_pin, uint8_t rw_pin,
+                                uint8_t en_pin, volatile uint8_t *data) {
+    // Construct `hd44780_par_t` object.
+    hd44780_par_t p;
+
+    p.port = port;
+    p.data = data ? data : port;
+
+    // `p`. `p.<>` stores the mask of each pin
+    p.rs = _BV(rs_pin);
+    p.rw = (rw_pin == LCD_NO_RW) ? 0 : _BV(rw_pin);
+    p.en = _BV(en_pin);
+
+    /* Configure port+pin direction */
+    DDR(port) |=  p.rs | p.rw | p.en;
+    DDR(p.data) |= data ? 0xff : 0x0f;
+
+    //Set ENABLE, RS and RW (write) pins to LOW state
+    PORT(port) &= ~p.en & ~p.rs & ~p.rw;
+
+    // Wait for LCD to become ready (docs say 15ms+)
+    p.init_state = BIND_POWER;
+    p.init_deadline = HD44780_PAR_POWER_ON_MS;
+    p.queue = NULL;
+
+    // Set by hd44780_par_step()
+    p.hd.send = data ? hd44780_par_send8 : hd44780_par_send4;
+    p.hd.function = (data ? LCD_8BITMODE : LCD_4BITMODE) | LCD_2LINE | LCD_5x8DOTS;
+    p.hd.params = 0;
+    p.hd.mode = 0;
+    p.hd.addr = LCD_ADDR_UNKNOWN;
+
+    return p;
+}
+
+
+bool hd44780_par_step(hd44780_par_t *p, uint16_t now_ms) {
+    if (p->init_state == BIND_DONE)
+      return true;
+    if ((int16_t)(now_ms - p->init_deadline) < 0)
+      return false;
+
+    switch (p->init_state) {
+    case BIND_POWER:
+    case BIND_8BIT_2:
+    case BIND_8BIT_3:
+      // 8-bit function set, whatever the current bus width
+      if (p->hd.function & LCD_8BITMODE) {
+        hd44780_par_write_byte(p, LCD_FUNCTIONSET | LCD_8BITMODE);
+      } else {
+        hd44780_par_write_nibble(p, 0x03);
+      }
+      p->init_deadline = now_ms + ((p->init_state == BIND_8BIT_3) ?
+                                   1 :       // more than 100us
+                                   5 + 1);   // more than 4.1ms (+1 as now_ms may be about to tick)
+      break;
+    case BIND_MODE:
+      // Set 4-bit mode
+      if (!(p->hd.function & LCD_8BITMODE)) {
+        hd44780_par_write_nibble(p, 0x02);
+      }
+
+      // Configure params
+      hd44780_send(&p->hd, LCD_COMMAND, LCD_FUNCTIONSET | p->hd.function);
+
+      // Configure more params
+      p->hd.params = LCD_CURSOROFF | LCD_BLINKOFF;
+      hd44780_send(&p->hd, LCD_COMMAND, LCD_DISPLAYCONTROL | p->hd.params);
+
+      // Power on entry mode; the address counter is unknown until clear/home
+      p->hd.mode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+      p->hd.addr = LCD_ADDR_UNKNOWN;
+      break;
+    }
+    p->init_state++;
+    return p->init_state == BIND_DONE;
+}
@@ -0,0 +1,123 @@
+/** @file hd44780_par.h
+ *  @brief Parallel bus transports of the HD44780 protocol core.
+ *
+ *  The display is connected to AVR ports: RS, RW (optional) and EN on a
+ *  control port, and the data bus either on the low nibble of that same
+ *  port (4-bit bus, D4-D7 on bits 0-3) or on a whole port (8-bit bus,
+ *  D0-D7 on bits 0-7). Bytes are sent blocking, paced by fixed delays or
+ *  by the busy flag when RW is wired, or through an output queue that
+ *  the Timer2 compare interrupt clocks out.
+ *
+ *  The commands themselves are built by hd44780.h through the `hd`
+ *  member: e.g. `hd44780_move_cursor(&p.hd, 0, 1)`.
+ */
+
+#ifndef HD44780_PAR_H
+#define HD44780_PAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hd44780.h"
+
+#define HD44780_PAR_POWER_ON_MS 15   /**< Time the LCD needs after power on */
+
+#define LCD_NO_RW 0xFF       /**< RW pin tied to ground (write only) */
+
+/** Output queue bytes (power of 2, up to 128) */
+#ifndef LCD_QUEUE_SIZE
+#define LCD_QUEUE_SIZE 128
+#endif
+
+#define LCD_QUEUE_TICK_US 50 /**< Output queue interrupt period */
+
+/**
+ * @brief Output queue clocked out by the timer interrupt
+ * (see hd44780_par_attach_queue()).
+ */
+typedef struct {
+  uint8_t data[LCD_QUEUE_SIZE];
+  uint8_t rs[LCD_QUEUE_SIZE / 8];   /**< RS bit of each byte */
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  volatile bool low;     /**< High nibble of the tail byte already sent */
+  volatile uint8_t wait; /**< Ticks left for clear/home to execute */
+} hd44780_queue_t;
+
+/**
+ * @brief A display on a parallel bus.
+ */
+typedef struct {
+  hd44780_t hd;           /**< Controller state and transport (first member) */
+  volatile uint8_t *port; /**< Control port */
+  volatile uint8_t *data; /**< Data bus port (== `port` on a 4-bit bus) */
+  uint8_t rs;             /**< RS pin mask: sending data =1; sending intruction = 0 */
+  uint8_t rw;             /**< Read / Write pin mask (0 if not wired) */
+  uint8_t en;             /**< Enable pin mask */
+  hd44780_queue_t *queue; /**< Output queue (NULL: blocking) */
+  uint8_t init_state;
+  uint16_t init_deadline;
+} hd44780_par_t;
+
+
+/**
+ * @brief Creates the display object and configures its pins, without
+ * waiting. The display must then be initialized by calling
+ * hd44780_par_step() until it returns true.
+ *
+ * @param port The AVR port where the control pins are connected
+ * @param rs_pin The bit number where RS pin is connected
+ * @param rw_pin The bit number where RW pin is connected, or LCD_NO_RW
+ *        if RW is tied to ground
+ * @param en_pin The bit number where Enable pin is connected
+ * @param data The AVR port where D0-D7 are connected (bit n to Dn) for
+ *        a 8-bit bus, or NULL for a 4-bit bus with D4-D7 on the low
+ *        nibble of `port`
+ * @return The display object
+ */
+hd44780_par_t hd44780_par_start(volatile uint8_t *port, uint8_t rs_pin, uint8_t rw_pin,
+                                uint8_t en_pin, volatile uint8_t *data);
+
+
+/**
+ * @brief Advances the initialization. Never waits: a step is only
+ * executed once the delay required by the previous one has elapsed.
+ *
+ * @param p The display object
+ * @param now_ms Current time in ms since power on (wraps around)
+ * @return true once the display is ready
+ */
+bool hd44780_par_step(hd44780_par_t *p, uint16_t now_ms);
+
+
+/**
+ * @brief Leaves the display the time of a clear or return home just
+ * sent: 2ms, unless the busy flag or the queue take care of it.
+ */
+void hd44780_par_wait_slow(hd44780_par_t *p);
+
+
+/**
+ * @brief Attaches an output queue to an initialized display.
+ *
+ * @details From now on every byte is only stored, and the Timer2 compare
+ * interrupt sends one nibble every LCD_QUEUE_TICK_US, which honours the
+ * instruction times without waiting. Timer2 is used by this module and
+ * interrupts must be enabled. The queue and its interrupt are in their
+ * own module (hd44780_par_queue), linked only by programs that call
+ * this function. Only one display can have a queue at a time.
+ * Attaching NULL waits until the queue is empty, stops the
+ * interrupt and returns to blocking mode.
+ *
+ * @param p The display object
+ * @param q The queue, or NULL
+ */
+void hd44780_par_attach_queue(hd44780_par_t *p, hd44780_queue_t *q);
+
+
+/**
+ * @brief Checks if all queued bytes have been sent and executed.
+ * Always true without a queue.
+ */
+bool hd44780_par_queue_empty(hd44780_par_t *p);
+
+#endif
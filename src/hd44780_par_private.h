@@ -0,0 +1,28 @@
+/** @file hd44780_par_private.h
+ *  @brief Bus primitives shared by the modules of the parallel bus
+ *  transport (not needed by the library end user).
+ */
+
+#ifndef HD44780_PAR_PRIVATE_H
+#define HD44780_PAR_PRIVATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hd44780_par.h"
+
+/** @brief Sends a nibble (4-bit bus), pacing it unless queued. */
+void hd44780_par_write_nibble(hd44780_par_t *p, uint8_t nibble);
+
+/** @brief Sends a whole byte (8-bit bus), pacing it unless queued. */
+void hd44780_par_write_byte(hd44780_par_t *p, uint8_t value);
+
+/** @brief Selects the data (LCD_DATA) or instruction (LCD_COMMAND) register. */
+void hd44780_par_rs(hd44780_par_t *p, bool rs_mode);
+
+/** @brief Blocking transport of the 4-bit bus. */
+void hd44780_par_send4(hd44780_t *h, bool rs_mode, uint8_t message);
+
+/** @brief Blocking transport of the 8-bit bus. */
+void hd44780_par_send8(hd44780_t *h, bool rs_mode, uint8_t message);
+
+#endif
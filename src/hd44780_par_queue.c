@@ -0,0 +1,121 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stddef.h>
+#include <util/delay.h>
+#include "hd44780_par.h"
+#include "hd44780_par_private.h"
+
+/*
+ * Output queue of the parallel bus. Kept apart from the transports so
+ * that only programs attaching a queue link the Timer2 interrupt.
+ */
+
+
+/*
+ * Transport of a queued display: stores the byte in the output queue
+ * and makes sure the timer interrupt is clocking it out. Waits while
+ * the queue is full.
+ */
+static void hd44780_par_send_queued(hd44780_t *h, bool rs_mode, uint8_t message) {
+  hd44780_queue_t *q = ((hd44780_par_t *)h)->queue;
+  const uint8_t head = q->head;
+  const uint8_t i = head & (LCD_QUEUE_SIZE - 1);
+
+  while ((uint8_t)(head - q->tail) == LCD_QUEUE_SIZE)
+    ;   // the interrupt makes room
+
+  q->data[i] = message;
+  if (rs_mode) {
+    q->rs[i >> 3] |= _BV(i & 0x07);
+  } else {
+    q->rs[i >> 3] &= ~_BV(i & 0x07);
+  }
+  q->head = head + 1;
+  TIMSK2 |= _BV(OCIE2A);
+  hd44780_track(h, rs_mode, message);
+}
+
+
+/*
+ * Timer2 ticks clocking the output queue: one nibble (or byte, on a
+ * 8-bit bus) per tick. The display is left LCD_QUEUE_SLOW_TICKS more
+ * ticks after clear and return home.
+ */
+#define LCD_QUEUE_TOP  (F_CPU / 8 * LCD_QUEUE_TICK_US / 1000000UL - 1)
+#define LCD_QUEUE_SLOW_TICKS  ((1520 + LCD_QUEUE_TICK_US - 1) / LCD_QUEUE_TICK_US)
+
+static hd44780_par_t *hd44780_par_queued;   // LCD served by the timer interrupt
+
+
+ISR(TIMER2_COMPA_vect) {
+  hd44780_par_t *p = hd44780_par_queued;
+  hd44780_queue_t *q = p->queue;
+
+  if (q->wait) {
+    q->wait--;
+    return;
+  }
+  if (q->tail == q->head) {
+    TIMSK2 &= ~_BV(OCIE2A);   // idle until next byte is queued
+    return;
+  }
+
+  const uint8_t i = q->tail & (LCD_QUEUE_SIZE - 1);
+  const uint8_t message = q->data[i];
+  const bool rs_mode = q->rs[i >> 3] & _BV(i & 0x07);
+
+  if (!q->low) {
+    hd44780_par_rs(p, rs_mode);
+    if (p->hd.function & LCD_8BITMODE) {
+      hd44780_par_write_byte(p, message);
+    } else {
+      hd44780_par_write_nibble(p, message >> 4);
+      q->low = true;
+      return;
+    }
+  } else {
+    hd44780_par_write_nibble(p, message);
+    q->low = false;
+  }
+
+  if (rs_mode == LCD_COMMAND && message <= (LCD_RETURNHOME | LCD_CLEARDISPLAY)) {
+    q->wait = LCD_QUEUE_SLOW_TICKS;
+  }
+  q->tail++;
+}
+
+
+void hd44780_par_attach_queue(hd44780_par_t *p, hd44780_queue_t *q) {
+  if (p->queue) {
+    while (!hd44780_par_queue_empty(p))
+      ;
+    _delay_us(LCD_QUEUE_TICK_US);   // last byte executing
+    TIMSK2 &= ~_BV(OCIE2A);
+    TCCR2B = 0;
+    hd44780_par_queued = NULL;
+  }
+
+  p->queue = q;
+  if (q) {
+    q->head = q->tail = 0;
+    q->low = false;
+    q->wait = 0;
+    hd44780_par_queued = p;
+    p->hd.send = hd44780_par_send_queued;
+
+    // CTC mode, prescaler 8: one tick every LCD_QUEUE_TICK_US
+    TCCR2A = _BV(WGM21);
+    TCCR2B = _BV(CS21);
+    OCR2A = LCD_QUEUE_TOP;
+    TCNT2 = 0;
+  } else {
+    p->hd.send = (p->hd.function & LCD_8BITMODE) ? hd44780_par_send8 : hd44780_par_send4;
+  }
+}
+
+
+bool hd44780_par_queue_empty(hd44780_par_t *p) {
+  hd44780_queue_t *q = p->queue;
+
+  return !q || (q->tail == q->head && !q->wait);
+}
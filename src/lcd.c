@@ -1,6 +1,7 @@
 //Source: https://github.com/aostanin/avr-hd44780
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -8,114 +9,129 @@
 #include "lcd.h"
 
 
-static uint8_t lcd_displayparams;
+/*
+ * Create the lcd object for a 4-bit bus and configure its pins,
+ * without waiting. D0-D3 data pins must be connected to the port's
+ * low nibble.
+ * See hd44780_par_start() for the parameters.
+ */
+lcd_t lcd_bind_start_rw(volatile uint8_t *port, uint8_t rs_pin, uint8_t rw_pin, uint8_t en_pin){
+    return hd44780_par_start(port, rs_pin, rw_pin, en_pin, NULL);
+}
 
 
 /*
- * Send a nibble-sized message to the LCD.
- * @param l The LCD object where the message must be adressed
- * @param nibble The 4-bit message to be sent
+ * Create the lcd object for a 8-bit bus and configure its pins,
+ * without waiting. D0-D7 are on the `data` port, control pins on
+ * `port`. Each byte is then a single transfer instead of two nibbles.
+ * See hd44780_par_start() for the parameters.
  */
-static void lcd_write_nibble(lcd_t l,uint8_t nibble) {
-  PORT(l.port) = (PORT(l.port) & 0xf0) | (nibble & 0x0f);
+lcd_t lcd_bind_start_8bit(volatile uint8_t *port, uint8_t rs_pin, uint8_t rw_pin, uint8_t en_pin,
+			  volatile uint8_t *data){
+    return hd44780_par_start(port, rs_pin, rw_pin, en_pin, data);
+}
 
-  //Enable pulse
-  PORT(l.port) &= ~l.en;
-  PORT(l.port) |= l.en;
-  PORT(l.port) &= ~l.en;
 
-  _delay_us(50); //Es pot provar de baixar
+/*
+ * Same as lcd_bind_start_rw() with RW tied to ground.
+ */
+lcd_t lcd_bind_start(volatile uint8_t *port, uint8_t rs_pin, uint8_t en_pin){
+    return lcd_bind_start_rw(port, rs_pin, LCD_NO_RW, en_pin);
 }
 
 
 /*
- * Sends a DATA or COMMAND byte instruction to the LCD.  Internally,
- * as the display is connected using 4-bit data bus, the function
- * splits the byte into two nibble-sized messages.
+ * Advance the initialization of a lcd object created by
+ * lcd_bind_start(). Never waits: a step is only executed once the
+ * delay required by the previous one has elapsed.
  *
- * @param l The LCD object where the message must be adressed
- * @param rs_mode Message is a LCD_COMMAND LCD_DATA
- * @param message The byte to be sent
+ * @param l The lcd object
+ * @param now_ms Current time in ms since power on (wraps around)
+ * @return true once the display is ready
  */
-void lcd_send(lcd_t l, bool rs_mode, uint8_t message) {
-  if (rs_mode) {
-    PORT(l.port) |= l.rs;
-  } else {
-    PORT(l.port) &= ~l.rs;
-  }
-  lcd_write_nibble(l,message >> 4);
-  lcd_write_nibble(l,message);
+bool lcd_bind_step(lcd_t *l, uint16_t now_ms) {
+    return hd44780_par_step(l, now_ms);
 }
 
 
 /*
  * Create and bind the lcd object.
  * D0-D3 data pins must be connected to the port's low nibble
- * The function takes about 25ms (blocking)
+ * The function takes about 25ms (blocking). Use lcd_bind_start_rw() and
+ * lcd_bind_step() to initialize other devices meanwhile.
  *
  * @param port The physical AVR port where the pins are connected
  * @param rs_pin The bit number where RS pin is connected.
+ * @param rw_pin The bit number where RW pin is connected, or LCD_NO_RW
+ *        if RW is tied to ground.
  * @param en_pin The bit number where Enable pin is connected.
  * @return The lcd object
  */
-lcd_t lcd_bind(volatile uint8_t *port, uint8_t rs_pin, uint8_t en_pin){
-    // Construct `lcd_t` object.
-    lcd_t l;
-
-    l.port = port;
-
-    // `l`. `l.<>_pin` stores the mask of each pin
-    l.rs = _BV(rs_pin);
-    l.en = _BV(en_pin);
+lcd_t lcd_bind_rw(volatile uint8_t *port, uint8_t rs_pin, uint8_t rw_pin, uint8_t en_pin){
+    lcd_t l = lcd_bind_start_rw(port, rs_pin, rw_pin, en_pin);
 
-    /* Configure port+pin direction */
-    DDR(port) |=  l.rs | l.en | 0x0f;
+    for (uint16_t t = 0; !lcd_bind_step(&l, t); t++) {
+      _delay_ms(1);
+    }
+    return l;
+  }
 
-    // Wait for LCD to become ready (docs say 15ms+)
-    _delay_ms(15);
 
-    //Set ENABLE and RS pins to LOW state
-    PORT(port) &= ~l.en & ~l.rs;
+/*
+ * Create and bind the lcd object on a 8-bit bus. The function takes
+ * about 25ms (blocking). Use lcd_bind_start_8bit() and lcd_bind_step()
+ * to initialize other devices meanwhile.
+ * See hd44780_par_start() for the parameters.
+ */
+lcd_t lcd_bind_8bit(volatile uint8_t *port, uint8_t rs_pin, uint8_t rw_pin, uint8_t en_pin,
+		    volatile uint8_t *data){
+    lcd_t l = lcd_bind_start_8bit(port, rs_pin, rw_pin, en_pin, data);
 
-    lcd_write_nibble(l, 0x03); // 1st time
-    _delay_ms(4.2);
-    lcd_write_nibble(l, 0x03); // 2nd time
-    _delay_ms(4.2)   ;         // Docs says more than 100us
-    lcd_write_nibble(l, 0x03); // 3rd time
-    _delay_us(100);
+    for (uint16_t t = 0; !lcd_bind_step(&l, t); t++) {
+      _delay_ms(1);
+    }
+    return l;
+  }
 
-    // Set 4-bit mode
-    lcd_write_nibble(l, 0x02);
 
-    // Configure params
-    lcd_send(l, LCD_COMMAND, LCD_FUNCTIONSET |
-	        LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS);
+/*
+ * Same as lcd_bind_rw() with RW tied to ground.
+ */
+lcd_t lcd_bind(volatile uint8_t *port, uint8_t rs_pin, uint8_t en_pin){
+    return lcd_bind_rw(port, rs_pin, LCD_NO_RW, en_pin);
+  }
 
-    // Configure more params
-    lcd_displayparams = LCD_CURSOROFF | LCD_BLINKOFF;
-    lcd_send(l, LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
 
-    return l;
-  }
+/*
+ * Sends a DATA or COMMAND byte instruction to the LCD, through the
+ * transport of its bus (4-bit, 8-bit or the output queue).
+ *
+ * @param l The LCD object where the message must be adressed
+ * @param rs_mode Message is a LCD_COMMAND LCD_DATA
+ * @param message The byte to be sent
+ */
+void lcd_send(lcd_t *l, bool rs_mode, uint8_t message) {
+  hd44780_send(&l->hd, rs_mode, message);
+}
 
 
 /*
  * Turns the LCD ON
  * @param l The LCD object to turn ON
  */
-void lcd_on(lcd_t l) {
-  lcd_displayparams |= LCD_DISPLAYON;
-  lcd_send(l, LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
+void lcd_on(lcd_t *l) {
+  hd44780_display(&l->hd, LCD_DISPLAYON, true);
 }
 
 
 /*
- * Clears the LCD display. The function takes 2ms (blocking)
+ * Clears the LCD display. The function takes 2ms (blocking) unless
+ * the RW pin is wired or a queue is attached
  * @param l The LCD object that must be cleared
  */
-void lcd_clear(lcd_t l) {
-  lcd_send(l, LCD_COMMAND, LCD_CLEARDISPLAY);
-  _delay_ms(2);   //Atention!
+void lcd_clear(lcd_t *l) {
+  hd44780_send(&l->hd, LCD_COMMAND, LCD_CLEARDISPLAY);
+  hd44780_par_wait_slow(l);
 }
 
 
@@ -123,20 +139,20 @@ void lcd_clear(lcd_t l) {
  * Turns the LCD OFF
  * @param l The LCD object
  */
-void lcd_off(lcd_t l) {
-  lcd_displayparams &= ~LCD_DISPLAYON;
-  lcd_send(l, LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
+void lcd_off(lcd_t *l) {
+  hd44780_display(&l->hd, LCD_DISPLAYON, false);
 }
 
 
 /*
  * Returns both display and cursor to the original 
- * position (address 0). The function takes 2ms (blocking)
+ * position (address 0). The function takes 2ms (blocking) unless
+ * the RW pin is wired or a queue is attached
  * @param l The LCD object
  */
-void lcd_return_home(lcd_t l) {
-  lcd_send(l, LCD_COMMAND, LCD_RETURNHOME);
-  _delay_ms(2); //Atention
+void lcd_return_home(lcd_t *l) {
+  hd44780_send(&l->hd, LCD_COMMAND, LCD_RETURNHOME);
+  hd44780_par_wait_slow(l);
 }
 
 
@@ -144,9 +160,8 @@ void lcd_return_home(lcd_t l) {
  * Enables the cursor blinking
  * @param l The LCD object
  */
-void lcd_enable_blinking(lcd_t l) {
-  lcd_displayparams |= LCD_BLINKON;
-  lcd_send(l, LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
+void lcd_enable_blinking(lcd_t *l) {
+  hd44780_display(&l->hd, LCD_BLINKON, true);
 }
 
 
@@ -154,9 +169,8 @@ void lcd_enable_blinking(lcd_t l) {
  * Disables the cursor blinking
  * @param l The LCD object
  */
-void lcd_disable_blinking(lcd_t l) {
-  lcd_displayparams &= ~LCD_BLINKON;
-  lcd_send(l,LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
+void lcd_disable_blinking(lcd_t *l) {
+  hd44780_display(&l->hd, LCD_BLINKON, false);
 }
 
 
@@ -164,9 +178,8 @@ void lcd_disable_blinking(lcd_t l) {
  * Enables the cursor visibility
  * @param l The LCD object
  */
-void lcd_enable_cursor(lcd_t l) {
-  lcd_displayparams |= LCD_CURSORON;
-  lcd_send(l, LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
+void lcd_enable_cursor(lcd_t *l) {
+  hd44780_display(&l->hd, LCD_CURSORON, true);
 }
 
 
@@ -174,9 +187,8 @@ void lcd_enable_cursor(lcd_t l) {
  * Disables the cursor visibility
  * @param l The LCD object
  */
-void lcd_disable_cursor(lcd_t l) {
-  lcd_displayparams &= ~LCD_CURSORON;
-  lcd_send(l, LCD_COMMAND, LCD_DISPLAYCONTROL | lcd_displayparams);
+void lcd_disable_cursor(lcd_t *l) {
+  hd44780_display(&l->hd, LCD_CURSORON, false);
 }
 
 
@@ -184,9 +196,8 @@ void lcd_disable_cursor(lcd_t l) {
  * Sets the scroll direction to LEFT
  * @param l The LCD object
  */
-void lcd_scroll_left(lcd_t l) {
-  lcd_send(l, LCD_COMMAND, LCD_CURSORSHIFT | LCD_DISPLAYMOVE |
-	      LCD_MOVELEFT);
+void lcd_scroll_left(lcd_t *l) {
+  hd44780_shift(&l->hd, LCD_DISPLAYMOVE | LCD_MOVELEFT);
 }
 
 
@@ -194,9 +205,8 @@ void lcd_scroll_left(lcd_t l) {
  * Sets the scroll direction to RIGHT
  * @param l The LCD object
  */
-void lcd_scroll_right(lcd_t l) {
-  lcd_send(l, LCD_COMMAND, LCD_CURSORSHIFT |
-	      LCD_DISPLAYMOVE | LCD_MOVERIGHT);
+void lcd_scroll_right(lcd_t *l) {
+  hd44780_shift(&l->hd, LCD_DISPLAYMOVE | LCD_MOVERIGHT);
 }
 
 
@@ -205,9 +215,8 @@ void lcd_scroll_right(lcd_t l) {
  * Means the cursor will move RIGHT at each written character.
  * @param l The LCD object
  */
-void lcd_set_left_to_right(lcd_t l) {
-  lcd_displayparams |= LCD_ENTRYLEFT;
-  lcd_send(l, LCD_COMMAND, LCD_ENTRYMODESET | lcd_displayparams);
+void lcd_set_left_to_right(lcd_t *l) {
+  hd44780_entry(&l->hd, LCD_ENTRYLEFT, true);
 }
 
 
@@ -216,9 +225,8 @@ void lcd_set_left_to_right(lcd_t l) {
  * will move LEFT at each written character.
  * @param l The LCD object
  */
-void lcd_set_right_to_left(lcd_t l) {
-  lcd_displayparams &= ~LCD_ENTRYLEFT;
-  lcd_send(l, LCD_COMMAND, LCD_ENTRYMODESET | lcd_displayparams);
+void lcd_set_right_to_left(lcd_t *l) {
+  hd44780_entry(&l->hd, LCD_ENTRYLEFT, false);
 }
 
 
@@ -226,9 +234,8 @@ void lcd_set_right_to_left(lcd_t l) {
  * Enables the autoscroll mode.
  * @param l The LCD object
  */
-void lcd_enable_autoscroll(lcd_t l) {
-  lcd_displayparams |= LCD_ENTRYSHIFTINCREMENT;
-  lcd_send(l, LCD_COMMAND, LCD_ENTRYMODESET | lcd_displayparams);
+void lcd_enable_autoscroll(lcd_t *l) {
+  hd44780_entry(&l->hd, LCD_ENTRYSHIFTINCREMENT, true);
 }
 
 
@@ -236,9 +243,8 @@ void lcd_enable_autoscroll(lcd_t l) {
  * Disables the autoscroll mode.
  * @param l The LCD object
  */
-void lcd_disable_autoscroll(lcd_t l) {
-  lcd_displayparams &= ~LCD_ENTRYSHIFTINCREMENT;
-  lcd_send(l, LCD_COMMAND, LCD_ENTRYMODESET | lcd_displayparams);
+void lcd_disable_autoscroll(lcd_t *l) {
+  hd44780_entry(&l->hd, LCD_ENTRYSHIFTINCREMENT, false);
 }
 
 
@@ -252,24 +258,20 @@ void lcd_disable_autoscroll(lcd_t l) {
  * @param location The address to save the new character.
  * @param charmap The charmap containing the new char information
  */
-void lcd_create_char(lcd_t l, uint8_t location, uint8_t *charmap) {
-  lcd_send(l, LCD_COMMAND, (LCD_SETCGRAMADDR | ((location & 0x07) << 3)));
-  for (int i = 0; i < 8; i++) {
-    lcd_send(l, LCD_DATA, *charmap);
-    charmap++;
-  }
+void lcd_create_char(lcd_t *l, uint8_t location, uint8_t *charmap) {
+  hd44780_create_char(&l->hd, location, charmap);
 }
 
 
 /*
- * Move the LCD cursor to the desired position
+ * Move the LCD cursor to the desired position.
+ * Nothing is sent if the cursor is already there.
  * @param l The LCD object
  * @param col The column
  * @param row The row
  */
-void lcd_move_cursor(lcd_t l, uint8_t col, uint8_t row) {
-  static uint8_t offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-  lcd_send(l, LCD_COMMAND, LCD_SETDDRAMADDR | (col + offsets[row]));
+void lcd_move_cursor(lcd_t *l, uint8_t col, uint8_t row) {
+  hd44780_move_cursor(&l->hd, col, row);
 }
 
 
@@ -278,10 +280,8 @@ void lcd_move_cursor(lcd_t l, uint8_t col, uint8_t row) {
  * @param l The LCD object to send the string
  * @param string The string object to be sent
  */
-void lcd_print(lcd_t l, char *string) {
-  for (char *it = string; *it; it++) {
-    lcd_send(l, LCD_DATA, *it);
-  }
+void lcd_print(lcd_t *l, char *string) {
+  hd44780_print(&l->hd, string);
 }
 
 
@@ -290,7 +290,7 @@ void lcd_print(lcd_t l, char *string) {
  * @param l The LCD object
  * @param format The
  */
-void lcd_printf(lcd_t l, char *format, ...) {
+void lcd_printf(lcd_t *l, char *format, ...) {
   va_list args;
   char lcd_buffer[LCD_COL_COUNT + 1];
 
@@ -300,3 +300,31 @@ void lcd_printf(lcd_t l, char *format, ...) {
 
   lcd_print(l, lcd_buffer);
 }
+
+
+/*
+ * Sends a string stored in flash (PSTR or PROGMEM) to the LCD.
+ * The string is read with pgm_read_byte and never copied to SRAM.
+ * @param l The LCD object to send the string
+ * @param string The string, in program memory
+ */
+void lcd_print_P(lcd_t *l, const char *string) {
+  hd44780_print_P(&l->hd, string);
+}
+
+
+/*
+ * Prints a formated string on the LCD, with the format stored in flash
+ * @param l The LCD object
+ * @param format The format, in program memory
+ */
+void lcd_printf_P(lcd_t *l, const char *format, ...) {
+  va_list args;
+  char lcd_buffer[LCD_COL_COUNT + 1];
+
+  va_start(args, format);
+  vsnprintf_P(lcd_buffer, LCD_COL_COUNT + 1, format, args);
+  va_end(args);
+
+  lcd_print(l, lcd_buffer);
+}
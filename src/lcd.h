@@ -7,10 +7,19 @@
 #include <stdbool.h>
 
 /* A 'lcd_t' is an abstraction of an LCD display using the HD44780
- * controller.  It is currently implemented to use a 4 bit data
- * connection.
+ * controller.  It can use a 4 bit data connection (D4-D7 on the low
+ * nibble of the control port) or a 8 bit one (D0-D7 on a whole port).
+ * Every display keeps its own state, so the API takes a pointer to the
+ * object returned by lcd_bind().
+ *
+ * This is the convenience API of the parallel transport: the commands
+ * are built by the HD44780 core (hd44780.h) and the bus is driven by
+ * hd44780_par.h.
  */
 
+#include "hd44780.h"
+#include "hd44780_par.h"
+
 #define PORT(x) (*(x))
 #define DDR(x)  (*(x-1))   // consider DDRy = PORTy - 1
 #define PIN(x)  (*(x-2))   // consider PINy = PORTy - 2
@@ -18,53 +27,8 @@
 #define LCD_COL_COUNT 20
 #define LCD_ROW_COUNT 4   //Not used
 
-// The rest should be left alone
-#define LCD_CLEARDISPLAY   0x01
-#define LCD_RETURNHOME     0x02
-#define LCD_ENTRYMODESET   0x04
-#define LCD_DISPLAYCONTROL 0x08
-#define LCD_CURSORSHIFT    0x10
-#define LCD_FUNCTIONSET    0x20
-#define LCD_SETCGRAMADDR   0x40
-#define LCD_SETDDRAMADDR   0x80
-
-#define LCD_ENTRYRIGHT          0x00
-#define LCD_ENTRYLEFT           0x02
-#define LCD_ENTRYSHIFTINCREMENT 0x01
-#define LCD_ENTRYSHIFTDECREMENT 0x00
-
-#define LCD_DISPLAYON  0x04
-#define LCD_DISPLAYOFF 0x00
-#define LCD_CURSORON   0x02
-#define LCD_CURSOROFF  0x00
-#define LCD_BLINKON    0x01
-#define LCD_BLINKOFF   0x00
-
-#define LCD_DISPLAYMOVE 0x08
-#define LCD_CURSORMOVE  0x00
-#define LCD_MOVERIGHT   0x04
-#define LCD_MOVELEFT    0x00
-
-#define LCD_8BITMODE 0x10
-#define LCD_4BITMODE 0x00
-#define LCD_2LINE    0x08
-#define LCD_1LINE    0x00
-#define LCD_5x10DOTS 0x04
-#define LCD_5x8DOTS  0x00
-
-#define LCD_COMMAND false
-#define LCD_DATA    true
-
-typedef struct {
-  volatile uint8_t *port;
-  uint8_t rs; // sending data =1; sending intruction = 0
-  uint8_t rw; // Read / Write pin
-  uint8_t en; // Enable pin
-  uint8_t D0; // Data bits
-  uint8_t D1;
-  uint8_t D2;
-  uint8_t D3;
-} lcd_t;
+typedef hd44780_par_t lcd_t;
+typedef hd44780_queue_t lcd_queue_t;
 
 
 /* Create and bind the lcd */
@@ -73,35 +37,84 @@ lcd_t lcd_bind(
   uint8_t rs_pin,
   uint8_t en_pin);
 
-void lcd_send(lcd_t l, bool rs_mode, uint8_t value);
+/* Create and bind a lcd with the RW pin wired: the busy flag is
+ * polled instead of waiting fixed delays */
+lcd_t lcd_bind_rw(
+  volatile uint8_t *port,
+  uint8_t rs_pin,
+  uint8_t rw_pin,
+  uint8_t en_pin);
+
+/* Create and bind a lcd on a 8-bit bus: D0-D7 on the data port,
+ * control pins on port */
+lcd_t lcd_bind_8bit(
+  volatile uint8_t *port,
+  uint8_t rs_pin,
+  uint8_t rw_pin,
+  uint8_t en_pin,
+  volatile uint8_t *data);
+
+/* Create the lcd and initialize it without blocking */
+lcd_t lcd_bind_start(
+  volatile uint8_t *port,
+  uint8_t rs_pin,
+  uint8_t en_pin);
+lcd_t lcd_bind_start_rw(
+  volatile uint8_t *port,
+  uint8_t rs_pin,
+  uint8_t rw_pin,
+  uint8_t en_pin);
+lcd_t lcd_bind_start_8bit(
+  volatile uint8_t *port,
+  uint8_t rs_pin,
+  uint8_t rw_pin,
+  uint8_t en_pin,
+  volatile uint8_t *data);
+bool lcd_bind_step(lcd_t *l, uint16_t now_ms);
+
+void lcd_send(lcd_t *l, bool rs_mode, uint8_t value);
+
+/* Send through a queue, clocked out by a timer interrupt. Inline, so
+ * only the programs using the queue link its interrupt */
+static inline void lcd_attach_queue(lcd_t *l, lcd_queue_t *q) {
+  hd44780_par_attach_queue(l, q);
+}
+
+static inline bool lcd_queue_empty(lcd_t *l) {
+  return hd44780_par_queue_empty(l);
+}
+
 
+void lcd_on(lcd_t *l);
+void lcd_off(lcd_t *l);
 
-void lcd_on(lcd_t l);
-void lcd_off(lcd_t l);
+void lcd_clear(lcd_t *l);
+void lcd_return_home(lcd_t *l);
 
-void lcd_clear(lcd_t l);
-void lcd_return_home(lcd_t l);
+void lcd_enable_blinking(lcd_t *l);
+void lcd_disable_blinking(lcd_t *l);
 
-void lcd_enable_blinking(lcd_t l);
-void lcd_disable_blinking(lcd_t l);
+void lcd_enable_cursor(lcd_t *l);
+void lcd_disable_cursor(lcd_t *l);
 
-void lcd_enable_cursor(lcd_t l);
-void lcd_disable_cursor(lcd_t l);
+void lcd_scroll_left(lcd_t *l);
+void lcd_scroll_right(lcd_t *l);
 
-void lcd_scroll_left(lcd_t l);
-void lcd_scroll_right(lcd_t l);
+void lcd_set_left_to_right(lcd_t *l);
+void lcd_set_right_to_left(lcd_t *l);
 
-void lcd_set_left_to_right(lcd_t l);
-void lcd_set_right_to_left(lcd_t l);
+void lcd_enable_autoscroll(lcd_t *l);
+void lcd_disable_autoscroll(lcd_t *l);
 
-void lcd_enable_autoscroll(lcd_t l);
-void lcd_disable_autoscroll(lcd_t l);
+void lcd_create_char(lcd_t *l, uint8_t location, uint8_t charmap[8]);
 
-void lcd_create_char(lcd_t l, uint8_t location, uint8_t charmap[8]);
+void lcd_move_cursor(lcd_t *l, uint8_t col, uint8_t row);
 
-void lcd_move_cursor(lcd_t l, uint8_t col, uint8_t row);
+void lcd_print(lcd_t *l, char *string);
+void lcd_printf(lcd_t *l, char *format, ...);
 
-void lcd_print(lcd_t l, char *string);
-void lcd_printf(lcd_t l, char *format, ...);
+/* Same, with the string or format stored in flash */
+void lcd_print_P(lcd_t *l, const char *string);
+void lcd_printf_P(lcd_t *l, const char *format, ...);
 
 #endif
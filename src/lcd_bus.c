@@ -0,0 +1,91 @@
+#include <string.h>
+#include "lcd_bus.h"
+
+
+void lcd_bus_init(lcd_bus_t *b, uint16_t (*clock)(void)) {
+  memset(b, 0, sizeof(*b));
+  b->clock = clock;
+}
+
+
+uint8_t lcd_bus_add(lcd_bus_t *b, lcd_bus_poll_t poll, void *client) {
+  if (b->count == LCD_BUS_CLIENTS) {
+    return 0xFF;
+  }
+  b->poll[b->count] = poll;
+  b->client[b->count] = client;
+  return b->count++;
+}
+
+
+/*
+ * lcd_poll() with the signature of a `lcd_bus_poll_t`.
+ */
+static bool lcd_bus_poll_lcd(void *client) {
+  return lcd_poll((lcd_t *)client);
+}
+
+
+uint8_t lcd_bus_add_lcd(lcd_bus_t *b, lcd_t *l) {
+  const uint8_t i = lcd_bus_add(b, lcd_bus_poll_lcd, l);
+
+  if (i != 0xFF) {
+    lcd_set_yield(l, lcd_bus_yield, b);
+  }
+  return i;
+}
+
+
+bool lcd_bus_poll(lcd_bus_t *b) {
+  bool idle = true;
+
+  if (b->running || !b->count) {
+    return true;
+  }
+  b->running = true;
+
+  const uint16_t now = b->clock();
+  uint8_t i = b->next;
+  for (uint8_t n = 0; n < b->count; n++) {
+    lcd_bus_stats_t *s = &b->stats[i];
+
+    if (b->poll[i](b->client[i])) {
+      //Burst finished: this poll may have handed over its last transaction.
+      //A burst sent whole by one poll looks idle and is not measured
+      if (s->pending) {
+        s->pending = false;
+        s->latency_last = now - s->since;
+        if (s->latency_last > s->latency_max) {
+          s->latency_max = s->latency_last;
+        }
+      }
+    } else {
+      if (!s->pending) {
+        s->pending = true;
+        s->since = now;
+      }
+      s->slices++;
+      idle = false;
+    }
+    if (++i == b->count) {
+      i = 0;
+    }
+  }
+
+  //Next round starts one client further, so none is always served first
+  if (++b->next >= b->count) {
+    b->next = 0;
+  }
+  b->running = false;
+  return idle;
+}
+
+
+void lcd_bus_yield(void *b) {
+  lcd_bus_poll((lcd_bus_t *)b);
+}
+
+
+const lcd_bus_stats_t *lcd_bus_stats(const lcd_bus_t *b, uint8_t client) {
+  return &b->stats[client];
+}
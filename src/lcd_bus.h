@@ -0,0 +1,122 @@
+/** @file lcd_bus.h
+ *  @brief Fair scheduling of several `lcd_i2c` panels (and other I2C
+ *  clients) sharing one bus.
+ *
+ *  Every client has a non-blocking poll function that hands at most one
+ *  transaction to the i2c queue, such as lcd_poll(). lcd_bus_poll() polls
+ *  the clients round-robin, one time slice each, so a panel with a lot
+ *  of output can not delay the others by more than one transaction per
+ *  round. Panels added with lcd_bus_add_lcd() also run the scheduler
+ *  while one of their blocking functions waits, so a long `lcd_print` on
+ *  one panel keeps the other panels refreshing.
+ *
+ *  For each client the scheduler measures the latency from the first
+ *  poll that finds output pending until the poll that finds it all sent.
+ *  Only bursts that span more than one round are measured: a poll
+ *  function only tells whether output is left, so a burst handed over
+ *  whole in a single poll can not be told apart from an idle client.
+ */
+
+#ifndef LCD_BUS_H
+#define LCD_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lcd_i2c.h"
+
+/** Maximum number of clients of a bus */
+#ifndef LCD_BUS_CLIENTS
+#define LCD_BUS_CLIENTS 6
+#endif
+
+/**
+ * @brief Non-blocking poll of a client.
+ * @return true if the client has nothing left to send
+ */
+typedef bool (*lcd_bus_poll_t)(void *client);
+
+/**
+ * @brief Counters of a client of the bus.
+ */
+typedef struct {
+  uint16_t slices;       /**< Rounds that ended with output still pending */
+  uint16_t latency_last; /**< ms to send the last burst spanning rounds */
+  uint16_t latency_max;  /**< Worst `latency_last` so far */
+  uint16_t since;        /**< When the current burst was first seen */
+  bool pending;          /**< A burst is being sent */
+} lcd_bus_stats_t;
+
+/**
+ * @brief A bus and its clients.
+ */
+typedef struct {
+  lcd_bus_poll_t poll[LCD_BUS_CLIENTS];
+  void *client[LCD_BUS_CLIENTS];
+  lcd_bus_stats_t stats[LCD_BUS_CLIENTS];
+  uint8_t count;         /**< Number of clients */
+  uint8_t next;          /**< Client polled first in the next round */
+  bool running;          /**< A round is in progress */
+  uint16_t (*clock)(void);
+} lcd_bus_t;
+
+
+/**
+ * @brief Initializes a bus without clients.
+ *
+ * @param b The bus
+ * @param clock Returns the current time in ms (wraps around), used by
+ *        the latency counters
+ */
+void lcd_bus_init(lcd_bus_t *b, uint16_t (*clock)(void));
+
+
+/**
+ * @brief Adds a client to the bus.
+ *
+ * @param b The bus
+ * @param poll Its poll function
+ * @param client Argument passed to `poll`
+ * @return The client index (to read its counters), or 0xFF if the bus
+ *         is full
+ */
+uint8_t lcd_bus_add(lcd_bus_t *b, lcd_bus_poll_t poll, void *client);
+
+
+/**
+ * @brief Adds a panel to the bus, polled with lcd_poll(). Its blocking
+ * functions will run the scheduler while they wait (see lcd_set_yield()).
+ *
+ * @param b The bus
+ * @param l Pointer to the LCD object
+ * @return The client index, or 0xFF if the bus is full
+ */
+uint8_t lcd_bus_add_lcd(lcd_bus_t *b, lcd_t *l);
+
+
+/**
+ * @brief Runs one round: each client is polled once, starting one client
+ * further than the previous round. Never blocks. Does nothing when
+ * called from inside a round (e.g. from a client).
+ *
+ * @param b The bus
+ * @return true if no client has output pending
+ */
+bool lcd_bus_poll(lcd_bus_t *b);
+
+
+/**
+ * @brief lcd_bus_poll() with the signature of a `lcd_yield_t`.
+ * @param b The bus
+ */
+void lcd_bus_yield(void *b);
+
+
+/**
+ * @brief Gets the counters of a client.
+ *
+ * @param b The bus
+ * @param client The client index
+ */
+const lcd_bus_stats_t *lcd_bus_stats(const lcd_bus_t *b, uint8_t client);
+
+#endif
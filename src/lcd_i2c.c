@@ -1,5 +1,9 @@
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <util/delay.h>
 #include <util/atomic.h>
 #include "lcd_i2c.h"
@@ -11,41 +15,12 @@
 #define LCD_EN_PIN          0x04
 #define LCD_BACKLIGHT_PIN   0x08
 
-//Main instructions (page 24)
-#define LCD_CLEARDISPLAY   0x01
-
-#define LCD_RETURNHOME     0x02
-
-#define LCD_ENTRYMODESET   0x04 
-  #define LCD_ENTRYRIGHT          0x00
-  #define LCD_ENTRYLEFT           0x02
-  #define LCD_AUTOSCROLL_ON       0x01
-  #define LCD_AUTOSCROLL_OFF      0x00  
-
-#define LCD_DISPLAYCONTROL 0x08
-  #define LCD_DISPLAYON  0x04
-  #define LCD_DISPLAYOFF 0x00
-  #define LCD_CURSORON   0x02
-  #define LCD_CURSOROFF  0x00
-  #define LCD_BLINKON    0x01
-  #define LCD_BLINKOFF   0x00
-
-#define LCD_CURSORSHIFT    0x10
-  #define LCD_DISPLAYMOVE 0x08
-  #define LCD_CURSORMOVE  0x00
-  #define LCD_MOVERIGHT   0x04
-  #define LCD_MOVELEFT    0x00
-
-#define LCD_FUNCTIONSET    0x20
-  #define LCD_8BITMODE  0x10
-  #define LCD_4BITMODE  0x00
-  #define LCD_2LINE     0x08
-  #define LCD_1LINE     0x00
-  #define LCD_5x10DOTS  0x04
-  #define LCD_5x8DOTS   0x00
-
-#define LCD_SETCGRAMADDR   0x40
-#define LCD_SETDDRAMADDR   0x80
+//Expander output while reading the busy flag (COMMAND mode, RW high).
+//High nibble on HIGH to be able to read D7-D4 pins
+#define LCD_BF_READ         (0xF0 | LCD_BACKLIGHT_PIN | LCD_RW_PIN)
+
+//Clean cells that a flush run may swallow instead of issuing a new SETDDRAMADDR
+#define LCD_SHADOW_GAP      1
 
 /**
  * @brief Defines the two different types of messages to the display
@@ -56,77 +31,288 @@ typedef enum {
 } rs_mode_t;
 
 
+static void lcd_transport(hd44780_t *h, bool rs_mode, uint8_t message);
+
+
 lcd_t lcd_constructor(const uint8_t i2c_address, const uint8_t rows){
   lcd_t l = {
     i2c_address,
     rows,
-    0,            //Function
-    0,            //Params
-    0,            //Mode
+    { lcd_transport, 0, 0, 0, LCD_ADDR_UNKNOWN }, //HD44780 state: transport, function, params, mode, DDRAM address counter
     Success,      //Last I2C request status
     0xFF,         //Recieve buffer
+    0,            //Busy flag read transfers queued
+    NULL,         //Shadow framebuffer
+    NULL,         //Double-buffered screen
+    NULL,         //Glyph cache
+    {0},          //Transmit buffer
+    {0},          //Transmit ring
+    {0},          //Transmit ring RS bits
+    0,            //Transmit ring head
+    0,            //Transmit ring tail
+    LCD_PACE_DELAY, //Pacing mode
+    false,        //Slow command pending
+    0,            //Init state
+    0,            //Init step deadline
+    NULL,         //Yield while waiting
+    NULL,         //Yield argument
   };
   return l;
 }
 
 
-static void lcd_write_nibble(lcd_t *l, uint8_t nibble, volatile i2c_status_t * st) {
-  while (i2c_swamped());
-  i2c_send_uint8(l->i2c_address,
-                  nibble | LCD_EN_PIN, 
-                  NULL);
-  while (i2c_swamped());
-  i2c_send_uint8(l->i2c_address,
-                  nibble & ~LCD_EN_PIN,
-                  st);
+/**
+ * @brief Stores a DATA or COMMAND byte in the transmit ring of the LCD.
+ *
+ * @param l Pointer to the LCD object where the message must be adressed
+ * @param rs Message is a `COMMAND` or `DATA`
+ * @param message The byte to be sent
+ * @return false if the ring is full and the byte was not stored
+ */
+static bool lcd_push(lcd_t *l, const rs_mode_t rs, const uint8_t message) {
+  const uint8_t head = l->ring_head;
+  if ((uint8_t)(head - l->ring_tail) == LCD_RING_SIZE) {
+    return false;
+  }
+
+  const uint8_t i = head & (LCD_RING_SIZE - 1);
+  l->ring[i] = message;
+  if (rs == DATA) {
+    l->ring_rs[i >> 3] |= _BV(i & 0x07);
+  } else {
+    l->ring_rs[i >> 3] &= ~_BV(i & 0x07);
+  }
+  l->ring_head = head + 1;
+
+  //Track the address counter as the controller will see it
+  hd44780_track(&l->hd, rs == DATA, message);
+  return true;
 }
 
 
 /**
- * @brief Sends a DATA or COMMAND byte instruction to the LCD.
- * Internally, as the display is connected using 4-bit data bus over I2c,
- * the function splits the byte into two nibble-sized messages.
+ * @brief Stores a `SETDDRAMADDR` command in the transmit ring, unless
+ * the address counter will already hold that address.
+ *
+ * @param l Pointer to the LCD object
+ * @param addr The DDRAM address
+ * @return false if the ring is full and the command was not stored
+ */
+static bool lcd_push_addr(lcd_t *l, const uint8_t addr) {
+  return addr == l->hd.addr || lcd_push(l, COMMAND, LCD_SETDDRAMADDR | addr);
+}
+
+
+bool lcd_poll(lcd_t *l) {
+  if (l->ring_head == l->ring_tail) {
+    return true;
+  }
+  //`tx` still in use by the last transaction, or a slow command still executing
+  if (l->i2c_comm == Running || i2c_swamped() || !lcd_ready(l)) {
+    return false;
+  }
+
+  /* As the display is connected using 4-bit data bus over I2c, each byte
+   * becomes two nibble strobes (EN high, EN low) of 4 expander bytes.
+   * Consecutive writes are one expander byte apart (90us at 100kHz), which
+   * exceeds the 37us the controller needs to execute them.
+   */
+  uint8_t len = 0;
+  while (l->ring_tail != l->ring_head && len <= LCD_TX_SIZE - 4) {
+    const uint8_t i = l->ring_tail & (LCD_RING_SIZE - 1);
+    const uint8_t message = l->ring[i];
+    const rs_mode_t rs = (l->ring_rs[i >> 3] & _BV(i & 0x07)) ? DATA : COMMAND;
+    const uint8_t nibble = (rs | LCD_BACKLIGHT_PIN) & 0x0F;
+    l->ring_tail++;
+
+    l->tx[len++] = (message & 0xF0) | nibble | LCD_EN_PIN;         //High nibble
+    l->tx[len++] = (message & 0xF0) | nibble;
+    l->tx[len++] = ((message << 4) & 0xF0) | nibble | LCD_EN_PIN;  //Low nibble
+    l->tx[len++] = ((message << 4) & 0xF0) | nibble;
+
+    //Clear and return home take 1.52ms: nothing may follow them in the same transaction
+    if (rs == COMMAND && message <= (LCD_RETURNHOME | LCD_CLEARDISPLAY)) {
+      if (l->pacing == LCD_PACE_BUSY_FLAG) {
+        l->r_buffer = 0xFF;  //Discard any stale busy flag reading
+        l->pending = true;
+      }
+      break;
+    }
+  }
+  i2c_send(l->i2c_address, l->tx, len, &l->i2c_comm);
+
+  return l->ring_head == l->ring_tail;
+}
+
+
+/**
+ * @brief One iteration of a blocking wait: lets the yield function run,
+ * which is expected to poll this LCD as one client of a bus, and polls
+ * the LCD itself only if that made no progress (no yield function, one
+ * that does not poll it, or a scheduler already inside a round). So a
+ * panel on a bus gets one transaction per round, like the others.
+ * @param l Pointer to the LCD object
+ * @return true if the transmit ring is empty
+ */
+static bool lcd_wait(lcd_t *l) {
+  if (l->yield) {
+    const uint8_t tail = l->ring_tail;
+
+    l->yield(l->yield_ctx);
+    if (l->ring_tail != tail || l->ring_head == l->ring_tail) {
+      return l->ring_head == l->ring_tail;
+    }
+  }
+  return lcd_poll(l);
+}
+
+
+/**
+ * @brief Stores a byte in the transmit ring, polling the LCD while the
+ * ring is full.
+ *
+ * @param l Pointer to the LCD object where the message must be adressed
+ * @param rs Message is a `COMMAND` or `DATA`
+ * @param message The byte to be sent
+ */
+static void lcd_queue(lcd_t *l, const rs_mode_t rs, const uint8_t message) {
+  while (!lcd_push(l, rs, message)) {
+    lcd_wait(l);
+  }
+}
+
+
+/**
+ * @brief Transport of the HD44780 core: stores the byte in the transmit
+ * ring of the LCD owning `h`. Functions built on the core drain the
+ * ring afterwards, so multi-byte commands go out in one transaction.
+ */
+static void lcd_transport(hd44780_t *h, bool rs_mode, uint8_t message) {
+  lcd_t *l = (lcd_t *)((char *)h - offsetof(lcd_t, hd));
+  lcd_queue(l, rs_mode ? DATA : COMMAND, message);
+}
+
+
+/**
+ * @brief Moves the address counter, polling the LCD while the ring is full.
+ * Does nothing if the counter will already hold the address.
+ *
+ * @param l Pointer to the LCD object
+ * @param addr The DDRAM address
+ */
+static void lcd_queue_addr(lcd_t *l, const uint8_t addr) {
+  while (!lcd_push_addr(l, addr)) {
+    lcd_wait(l);
+  }
+}
+
+
+/**
+ * @brief Blocks until the whole transmit ring has been handed to the i2c queue.
+ * @param l Pointer to the LCD object
+ */
+static void lcd_drain(lcd_t *l) {
+  while (!lcd_wait(l));
+}
+
+
+/**
+ * @brief Sends a single DATA or COMMAND byte instruction to the LCD.
  *
  * @param l Pointer to the LCD object where the message must be adressed
  * @param rs Message is a `COMMAND` or `DATA`
  * @param message The byte to be sent
  */
 static void lcd_send(lcd_t *l, const rs_mode_t rs, const uint8_t message) {
-  while(l->i2c_comm == Running);  //If LCD is still pending on the last i2c command, function will block.
-  
-  uint8_t nibble = (rs | LCD_BACKLIGHT_PIN) & 0x0F;
-  
-  //High nibble
-  lcd_write_nibble(l, (message & 0xF0) | nibble, NULL);
-  
-  //Low nibble
-  lcd_write_nibble(l, ((message << 4) & 0xF0) | nibble, &l->i2c_comm);
+  lcd_queue(l, rs, message);
+  lcd_drain(l);
+}
+
+
+/**
+ * @brief Sends a single nibble strobe, used only during initialization
+ * while the controller is not yet in 4-bit mode.
+ *
+ * @param l Pointer to the LCD object
+ * @param nibble Expander byte (D7-D4 plus control pins) to be latched
+ */
+static void lcd_write_nibble(lcd_t *l, uint8_t nibble) {
+  lcd_drain(l);
+  while (l->i2c_comm == Running);  //`tx` still in use by the last i2c transaction
+  l->tx[0] = nibble | LCD_EN_PIN;
+  l->tx[1] = nibble & ~LCD_EN_PIN;
+  while (i2c_swamped());
+  i2c_send(l->i2c_address, l->tx, 2, &l->i2c_comm);
+}
+
+
+static bool lcd_shadow_is_dirty(const lcd_shadow_t *s, const uint8_t cell) {
+  return s->dirty[cell >> 3] & _BV(cell & 0x07);
+}
+
+
+/**
+ * @brief Writes a character into the shadow at the current position and
+ * advances it following the entry mode. Only cells whose contents really
+ * change are marked as dirty.
+ *
+ * @param l Pointer to the LCD object owning the shadow
+ * @param ch The character to be written
+ */
+static void lcd_shadow_put(lcd_t *l, const char ch) {
+  lcd_shadow_t *s = l->shadow;
+  const uint8_t size = l->rows * s->cols;
+
+  if (s->pos < size && s->cells[s->pos] != (uint8_t)ch) {
+    s->cells[s->pos] = ch;
+    s->dirty[s->pos >> 3] |= _BV(s->pos & 0x07);
+  }
+
+  if (l->hd.mode & LCD_ENTRYLEFT) {
+    s->pos = (s->pos + 1 < size) ? s->pos + 1 : 0;
+  } else {
+    s->pos = (s->pos > 0 && s->pos <= size) ? s->pos - 1 : size - 1;
+  }
 }
 
 
 void lcd_busy_flag_request(lcd_t *l){
-  if (l->i2c_comm == Running){
+  static const uint8_t pre[] = {
+    LCD_BF_READ,                //High nibble (D7-D4) on HIGH to be able to read it (PCF8574 requirement)
+    LCD_BF_READ | LCD_EN_PIN    //Rising edge ENABLE pulse
+  };
+  static const uint8_t post[] = {
+    LCD_BF_READ,                //Falling edge ENABLE pulse
+    //2nd ENABLE pulse is needed as LCD is working in 4-bit mode.
+    LCD_BF_READ | LCD_EN_PIN,   //Rising edge ENABLE pulse
+    LCD_BF_READ                 //Falling edge ENABLE pulse
+  };
+
+  if (l->bf_step == 0 && l->i2c_comm == Running){
     return;
   }  //If LCD is still pending on the last i2c command, function returns.
 
-  //High nibble on HIGH to be able to read D7-D4 pins
-  const uint8_t s_buffer = 0xF0 | COMMAND | LCD_BACKLIGHT_PIN | LCD_RW_PIN;
-
-  i2c_send_uint8(l->i2c_address, s_buffer, NULL);                 //High nibble (D7-D4) on HIGH to be able to read it (PCF8574 requirement)
-  i2c_send_uint8(l->i2c_address, s_buffer | LCD_EN_PIN, NULL);    //Rising edge ENABLE pulse
-  i2c_receive_uint8(l->i2c_address, &l->r_buffer, &l->i2c_comm);  //Receive byte I2C request. Busy flag will be stored at the MSB on `r_buffer`
-  i2c_send_uint8(l->i2c_address, s_buffer, NULL);                 //Falling edge ENABLE pulse
-
-  //2nd ENABLE pulse is needed as LCD is working in 4-bit mode.
-  i2c_send_uint8(l->i2c_address, s_buffer | LCD_EN_PIN, NULL);    //Rising edge ENABLE pulse
-  i2c_send_uint8(l->i2c_address, s_buffer, NULL);                 //Falling edge ENABLE pulse
+  //Each transfer is queued only when the i2c queue has room; the next call resumes the read
+  for (; l->bf_step < 3; l->bf_step++) {
+    if (i2c_swamped()) {
+      return;
+    }
+    if (l->bf_step == 0) {
+      i2c_send(l->i2c_address, (uint8_t *)pre, sizeof(pre), NULL);
+    } else if (l->bf_step == 1) {
+      i2c_receive_uint8(l->i2c_address, &l->r_buffer, &l->i2c_comm);  //Busy flag will be stored at the MSB on `r_buffer`
+    } else {
+      i2c_send(l->i2c_address, (uint8_t *)post, sizeof(post), NULL);
+    }
+  }
+  l->bf_step = 0;
 }
 
 
 bool lcd_is_busy_flag_set(lcd_t *l){
   bool busy_flag = true;
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-    if (l->i2c_comm == Success && !(l->r_buffer >> 7)) {                      //BF is cleared
+    if (l->bf_step == 0 && l->i2c_comm == Success && !(l->r_buffer >> 7)) {  //BF is cleared, read complete
       //Received buffer to 0xFF to reset the internal BF bit
       l->r_buffer = 0xFF;
       busy_flag = false;
@@ -136,153 +322,659 @@ bool lcd_is_busy_flag_set(lcd_t *l){
 }
 
 
-void lcd_init(lcd_t *l){
-	//The following seqüence is according to the Hitachi HD44780 datasheet (page 46)
-	//to init the LCD into 4 bit mode
+void lcd_set_pacing(lcd_t *l, const lcd_pacing_t pacing) {
+  lcd_drain(l);
+  while (!lcd_ready(l));
+  l->pacing = pacing;
+}
+
+
+void lcd_set_yield(lcd_t *l, lcd_yield_t yield, void *ctx) {
+  l->yield = yield;
+  l->yield_ctx = ctx;
+}
+
+
+bool lcd_ready(lcd_t *l) {
+  if (!l->pending) {
+    return true;
+  }
+  if (l->i2c_comm == Running) {
+    return false;
+  }
+  if (!lcd_is_busy_flag_set(l)) {
+    l->pending = false;
+    return true;
+  }
+  lcd_busy_flag_request(l);  //Nothing read yet or still busy: ask again
+  return false;
+}
 
-	lcd_write_nibble(l, 0x03 << 4, NULL);
-	_delay_ms(5); // Wait min 4.1ms
 
-	lcd_write_nibble(l, 0x03 << 4, NULL);
-	_delay_ms(5); // Wait min 4.1ms
+/**
+ * @brief Sends a command that takes up to 1.52ms to execute and paces it
+ * according to the LCD pacing mode.
+ *
+ * @param l Pointer to the LCD object
+ * @param command The slow command
+ * @param blocking Wait for the command to finish before returning
+ */
+static void lcd_send_slow(lcd_t *l, const uint8_t command, const bool blocking) {
+  lcd_send(l, COMMAND, command);
+  if (blocking) {
+    if (l->pacing == LCD_PACE_BUSY_FLAG) {
+      while (!lcd_ready(l)) {
+        if (l->yield) {
+          l->yield(l->yield_ctx);
+        }
+      }
+    } else {
+      _delay_ms(2);
+    }
+  }
+}
 
-	lcd_write_nibble(l, 0x03 << 4, NULL);
-	_delay_us(150);
 
-	//Finally, set to 4-bit interface
-	lcd_write_nibble(l, 0x02 << 4, NULL);
+/**
+ * @brief Steps of the asynchronous initialization. The sequence is
+ * according to the Hitachi HD44780 datasheet (page 46) to init the LCD
+ * into 4 bit mode.
+ */
+typedef enum {
+  INIT_POWER,    //Wait for Vcc to settle, 1st function set (8 bit)
+  INIT_8BIT_2,   //2nd function set (8 bit), min 4.1ms later
+  INIT_8BIT_3,   //3rd function set (8 bit), min 4.1ms later
+  INIT_4BIT,     //Switch to 4 bit, min 100us later
+  INIT_CONFIG,   //Lines, font, display off and clear
+  INIT_MODE,     //Entry mode and display on, once the clear has finished
+  INIT_DONE
+} init_state_t;
 
-	//Set # lines, font size, etc.
-  l->function = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
-	if (l->rows > 1) {
-		l->function |= LCD_2LINE;
-	}
-  lcd_send(l, COMMAND, LCD_FUNCTIONSET | l->function);
 
-	//Turn the display on with no cursor or blinking default
-	l->params = LCD_DISPLAYOFF | LCD_CURSOROFF | LCD_BLINKOFF;
-  lcd_send(l, COMMAND, LCD_DISPLAYCONTROL | l->params);
+/**
+ * @brief Sets the earliest time of the next initialization step.
+ * One extra ms is added as `now_ms` may be about to tick.
+ */
+static void lcd_init_wait(lcd_t *l, const uint16_t now_ms, const uint8_t ms) {
+  l->init_deadline = now_ms + ms + 1;
+}
 
-  lcd_clear(l, true);
 
-	//Set the entry mode. Initialize to default text direction (for roman languages)
-	l->mode = LCD_ENTRYLEFT | LCD_AUTOSCROLL_OFF;
-	lcd_send(l, COMMAND, LCD_ENTRYMODESET | l->mode);
+void lcd_init_start(lcd_t *l) {
+  l->init_state = INIT_POWER;
+  l->init_deadline = LCD_I2C_POWER_ON_MS;
+}
 
-  lcd_on(l);
+
+bool lcd_init_step(lcd_t *l, const uint16_t now_ms) {
+  if (l->init_state == INIT_DONE) {
+    return lcd_poll(l);
+  }
+  if ((int16_t)(now_ms - l->init_deadline) < 0 ||
+      !lcd_poll(l) || l->i2c_comm == Running || !lcd_ready(l)) {
+    return false;
+  }
+
+  switch (l->init_state) {
+  case INIT_POWER:
+  case INIT_8BIT_2:
+    lcd_write_nibble(l, 0x03 << 4);
+    lcd_init_wait(l, now_ms, 5);  //Wait min 4.1ms
+    break;
+  case INIT_8BIT_3:
+    lcd_write_nibble(l, 0x03 << 4);
+    lcd_init_wait(l, now_ms, 0);  //Wait min 100us
+    break;
+  case INIT_4BIT:
+    //Finally, set to 4-bit interface
+    lcd_write_nibble(l, 0x02 << 4);
+    break;
+  case INIT_CONFIG:
+    //Set # lines, font size, etc.
+    l->hd.function = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+    if (l->rows > 1) {
+      l->hd.function |= LCD_2LINE;
+    }
+    lcd_push(l, COMMAND, LCD_FUNCTIONSET | l->hd.function);
+
+    //Display off with no cursor or blinking default
+    l->hd.params = LCD_DISPLAYOFF | LCD_CURSOROFF | LCD_BLINKOFF;
+    lcd_push(l, COMMAND, LCD_DISPLAYCONTROL | l->hd.params);
+
+    lcd_push(l, COMMAND, LCD_CLEARDISPLAY);
+    lcd_poll(l);
+    if (l->pacing == LCD_PACE_DELAY) {
+      lcd_init_wait(l, now_ms, 2);
+    }
+    break;
+  case INIT_MODE:
+    //Set the entry mode. Initialize to default text direction (for roman languages)
+    l->hd.mode = LCD_ENTRYLEFT | LCD_AUTOSCROLL_OFF;
+    lcd_push(l, COMMAND, LCD_ENTRYMODESET | l->hd.mode);
+
+    l->hd.params |= LCD_DISPLAYON;
+    lcd_push(l, COMMAND, LCD_DISPLAYCONTROL | l->hd.params);
+    lcd_poll(l);
+    break;
+  default:
+    break;
+  }
+  l->init_state++;
+  return false;
+}
+
+
+void lcd_init(lcd_t *l){
+  //Caller already waited for power on: time starts at the power on deadline
+  lcd_init_start(l);
+  for (uint16_t t = LCD_I2C_POWER_ON_MS; !lcd_init_step(l, t); t++) {
+    _delay_ms(1);
+  }
 }
 
 
 void lcd_return_home(lcd_t *l, const bool blocking) {
-  lcd_send(l, COMMAND, LCD_RETURNHOME);
-  if (blocking){
-    _delay_ms(2);
+  if (l->shadow) {
+    l->shadow->pos = 0;
+    return;
   }
+  lcd_send_slow(l, LCD_RETURNHOME, blocking);
 }
 
 
 void lcd_on(lcd_t *l) {
-  l->params |= LCD_DISPLAYON;
-  lcd_send(l, COMMAND, LCD_DISPLAYCONTROL | l->params);
+  hd44780_display(&l->hd, LCD_DISPLAYON, true);
+  lcd_drain(l);
 }
 
 
 void lcd_off(lcd_t *l) {
-  l->params &= ~LCD_DISPLAYON;
-  lcd_send(l, COMMAND, LCD_DISPLAYCONTROL | l->params);
+  hd44780_display(&l->hd, LCD_DISPLAYON, false);
+  lcd_drain(l);
 }
 
 
 void lcd_clear(lcd_t *l, const bool blocking) {
-  lcd_send(l, COMMAND, LCD_CLEARDISPLAY);
-  if (blocking){
-    _delay_ms(2);
+  if (l->shadow) {
+    const uint8_t size = l->rows * l->shadow->cols;
+    for (uint8_t i = 0; i < size; i++) {
+      lcd_shadow_put(l, ' ');
+    }
+    l->shadow->pos = 0;
+    return;
   }
+  lcd_send_slow(l, LCD_CLEARDISPLAY, blocking);
 }
 
 
 void lcd_enable_blinking(lcd_t *l) {
-  l->params |= LCD_BLINKON;
-  lcd_send(l, COMMAND, LCD_DISPLAYCONTROL | l->params);
+  hd44780_display(&l->hd, LCD_BLINKON, true);
+  lcd_drain(l);
 }
 
 
 void lcd_disable_blinking(lcd_t *l) {
-  l->params &= ~LCD_BLINKON;
-  lcd_send(l,COMMAND, LCD_DISPLAYCONTROL | l->params);
+  hd44780_display(&l->hd, LCD_BLINKON, false);
+  lcd_drain(l);
 }
 
 
 void lcd_enable_cursor(lcd_t *l) {
-  l->params |= LCD_CURSORON;
-  lcd_send(l, COMMAND, LCD_DISPLAYCONTROL | l->params);
+  hd44780_display(&l->hd, LCD_CURSORON, true);
+  lcd_drain(l);
 }
 
 
 void lcd_disable_cursor(lcd_t *l) {
-  l->params &= ~LCD_CURSORON;
-  lcd_send(l, COMMAND, LCD_DISPLAYCONTROL | l->params);
+  hd44780_display(&l->hd, LCD_CURSORON, false);
+  lcd_drain(l);
 }
 
 
 void lcd_scroll_left(lcd_t *l) {
-  lcd_send(l, COMMAND,  LCD_CURSORSHIFT |
-                            LCD_DISPLAYMOVE |
-	                          LCD_MOVELEFT);
+  hd44780_shift(&l->hd, LCD_DISPLAYMOVE | LCD_MOVELEFT);
+  lcd_drain(l);
 }
 
 
 void lcd_scroll_right(lcd_t *l) {
-  lcd_send(l, COMMAND,  LCD_CURSORSHIFT |
-	                          LCD_DISPLAYMOVE | 
-                            LCD_MOVERIGHT);
+  hd44780_shift(&l->hd, LCD_DISPLAYMOVE | LCD_MOVERIGHT);
+  lcd_drain(l);
 }
 
 
 void lcd_set_left_to_right(lcd_t *l) {
-  l->params |= LCD_ENTRYLEFT;
-  lcd_send(l, COMMAND, LCD_ENTRYMODESET | l->params);
+  hd44780_entry(&l->hd, LCD_ENTRYLEFT, true);
+  lcd_drain(l);
 }
 
 
 void lcd_set_right_to_left(lcd_t *l) {
-  l->params &= ~LCD_ENTRYLEFT;
-  lcd_send(l, COMMAND, LCD_ENTRYMODESET | l->params);
+  hd44780_entry(&l->hd, LCD_ENTRYLEFT, false);
+  lcd_drain(l);
 }
 
 
 void lcd_enable_autoscroll(lcd_t *l) {
-  l->params |= LCD_AUTOSCROLL_ON;
-  lcd_send(l, COMMAND, LCD_ENTRYMODESET | l->params);
+  hd44780_entry(&l->hd, LCD_AUTOSCROLL_ON, true);
+  lcd_drain(l);
 }
 
 
 void lcd_disable_autoscroll(lcd_t *l) {
-  l->params &= ~LCD_AUTOSCROLL_ON;
-  lcd_send(l, COMMAND, LCD_ENTRYMODESET | l->params);
+  hd44780_entry(&l->hd, LCD_AUTOSCROLL_ON, false);
+  lcd_drain(l);
 }
 
 
 void lcd_create_char(lcd_t *l, uint8_t location, uint8_t *charmap) {
-  lcd_send(l, COMMAND, (LCD_SETCGRAMADDR | ((location & 0x07) << 3)));
-  for (int i = 0; i < 8; i++) {
-    lcd_send(l, DATA, *charmap);
-    charmap++;
-  }
+  hd44780_create_char(&l->hd, location, charmap);
+  lcd_drain(l);
 }
 
 
 void lcd_move_cursor(lcd_t *l, uint8_t col, uint8_t row) {
-  static uint8_t offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-  lcd_send(l, COMMAND, LCD_SETDDRAMADDR | (col + offsets[row]));
+  if (l->shadow) {
+    l->shadow->pos = row * l->shadow->cols + col;
+    return;
+  }
+  hd44780_move_cursor(&l->hd, col, row);
+  lcd_drain(l);
 }
 
 void lcd_print_ch(lcd_t *l, const char ch){
+  if (l->shadow) {
+    lcd_shadow_put(l, ch);
+    return;
+  }
   lcd_send(l, DATA, ch);
 }
 
+/**
+ * @brief Outputs a character to the shadow, if attached, or to the
+ * transmit ring. Ring output must be followed by lcd_drain().
+ *
+ * @param l Pointer to the LCD object
+ * @param ch The character to be printed
+ */
+static void lcd_put(lcd_t *l, const char ch) {
+  if (l->shadow) {
+    lcd_shadow_put(l, ch);
+  } else {
+    lcd_queue(l, DATA, ch);
+  }
+}
+
 void lcd_print(lcd_t *l, char *string) {
   for (char *it = string; *it; it++) {
-    lcd_send(l, DATA, *it);
+    lcd_put(l, *it);
+  }
+  lcd_drain(l);
+}
+
+
+/**
+ * @brief Prints a number with the `lcd_printf` field options.
+ * Digits are generated with 16 bit divisions while the value fits,
+ * as 32 bit divisions are several times slower on AVR.
+ *
+ * @param l Pointer to the LCD object
+ * @param value The absolute value
+ * @param negative Print a minus sign
+ * @param base 10 or 16
+ * @param width Minimum field width
+ * @param flags `'0'` zero padding, `'-'` left aligned, otherwise right aligned
+ * @param point Number of decimals of a fixed-point value (0 for integers)
+ */
+#define LCD_NUMBER_DIGITS 10   //2^32 - 1 has 10 decimal digits
+
+static void lcd_put_number(lcd_t *l, uint32_t value, const bool negative,
+                           const uint8_t base, uint8_t width, const char flags,
+                           const uint8_t point) {
+  char digits[LCD_NUMBER_DIGITS];
+  uint8_t n = 0;
+
+  do {
+    uint8_t d;
+    if (value <= UINT16_MAX) {
+      const uint16_t v = value;
+      d = v % base;
+      value = v / base;
+    } else {
+      d = value % base;
+      value /= base;
+    }
+    digits[n++] = (d < 10) ? '0' + d : 'a' - 10 + d;
+  } while (value || n <= point);  //Fixed-point keeps a leading "0."
+
+  uint8_t len = n + negative + (point ? 1 : 0);
+  if (flags != '-' && flags != '0') {
+    for (; width > len; width--) {
+      lcd_put(l, ' ');
+    }
+  }
+  if (negative) {
+    lcd_put(l, '-');
+  }
+  if (flags == '0') {
+    for (; width > len; width--) {
+      lcd_put(l, '0');
+    }
+  }
+  while (n) {
+    if (n == point) {
+      lcd_put(l, '.');
+    }
+    lcd_put(l, digits[--n]);
+  }
+  for (; width > len; width--) {
+    lcd_put(l, ' ');
+  }
+}
+
+
+/**
+ * @brief Reads a character of a string stored in SRAM or in flash.
+ */
+static char lcd_read_char(const char *p, const bool progmem) {
+  return progmem ? pgm_read_byte(p) : *p;
+}
+
+
+/**
+ * @brief Prints a string stored in SRAM or in flash, right aligned in a
+ * field of `width` characters (left aligned if `flags` is `'-'`).
+ */
+static void lcd_put_string(lcd_t *l, const char *str, const bool progmem,
+                           uint8_t width, const char flags) {
+  const uint8_t len = progmem ? strlen_P(str) : strlen(str);
+  for (; flags != '-' && width > len; width--) {
+    lcd_put(l, ' ');
+  }
+  for (char ch; (ch = lcd_read_char(str, progmem)); str++) {
+    lcd_put(l, ch);
+  }
+  for (; width > len; width--) {
+    lcd_put(l, ' ');
+  }
+}
+
+
+/**
+ * @brief Formats into the display path, see lcd_printf().
+ *
+ * @param l Pointer to the LCD object
+ * @param format The format string
+ * @param progmem The format string is stored in flash
+ * @param args The arguments
+ */
+static void lcd_vprintf(lcd_t *l, const char *format, const bool progmem, va_list args) {
+  char ch;
+
+  for (const char *it = format; (ch = lcd_read_char(it, progmem)); it++) {
+    if (ch != '%') {
+      lcd_put(l, ch);
+      continue;
+    }
+    ch = lcd_read_char(++it, progmem);
+
+    //Flags, width and precision
+    char flags = ' ';
+    if (ch == '0' || ch == '-') {
+      flags = ch;
+      ch = lcd_read_char(++it, progmem);
+    }
+    uint8_t width = 0;
+    for (; ch >= '0' && ch <= '9'; ch = lcd_read_char(++it, progmem)) {
+      width = width * 10 + (ch - '0');
+    }
+    uint8_t point = 0;
+    if (ch == '.') {
+      for (ch = lcd_read_char(++it, progmem); ch >= '0' && ch <= '9'; ch = lcd_read_char(++it, progmem)) {
+        point = point * 10 + (ch - '0');
+        if (point > LCD_NUMBER_DIGITS - 1) {
+          point = LCD_NUMBER_DIGITS - 1;   //"0." and the digits must fit
+        }
+      }
+    }
+    const bool is_long = (ch == 'l');
+    if (is_long) {
+      ch = lcd_read_char(++it, progmem);
+    }
+
+    switch (ch) {
+    case 'd':
+    case 'f': {
+      const int32_t v = is_long ? va_arg(args, long) : va_arg(args, int);
+      lcd_put_number(l, (v < 0) ? -(uint32_t)v : (uint32_t)v, v < 0, 10, width, flags,
+                     (ch == 'f') ? point : 0);
+      break;
+    }
+    case 'u':
+    case 'x': {
+      const uint32_t v = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+      lcd_put_number(l, v, false, (ch == 'x') ? 16 : 10, width, flags, 0);
+      break;
+    }
+    case 's':
+    case 'S':
+      lcd_put_string(l, va_arg(args, const char *), ch == 'S', width, flags);
+      break;
+    case 'c':
+      lcd_put(l, (char)va_arg(args, int));
+      break;
+    case '\0':
+      it--;   //Lone '%' at the end of the format
+      break;
+    default:
+      lcd_put(l, ch);  //"%%" and unknown conversions print the character
+      break;
+    }
+  }
+  lcd_drain(l);
+}
+
+
+void lcd_printf(lcd_t *l, char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  lcd_vprintf(l, format, false, args);
+  va_end(args);
+}
+
+
+void lcd_printf_P(lcd_t *l, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  lcd_vprintf(l, format, true, args);
+  va_end(args);
+}
+
+
+void lcd_print_P(lcd_t *l, const char *string) {
+  for (char ch; (ch = pgm_read_byte(string)); string++) {
+    lcd_put(l, ch);
+  }
+  lcd_drain(l);
+}
+
+
+void lcd_attach_shadow(lcd_t *l, lcd_shadow_t *s, const uint8_t cols) {
+  l->shadow = s;
+  l->page = NULL;
+  if (s) {
+    //Panel contents are unknown: first flush must rewrite everything
+    s->cols = cols;
+    s->pos = 0;
+    memset(s->cells, ' ', sizeof(s->cells));
+    memset(s->dirty, 0xFF, sizeof(s->dirty));
+  }
+}
+
+
+void lcd_flush(lcd_t *l) {
+  lcd_shadow_t *s = l->shadow;
+  if (!s) {
+    return;
+  }
+
+  //Runs are sent left to right, so entry mode is forced while flushing
+  const uint8_t mode = l->hd.mode;
+  const bool forced_mode = (mode & (LCD_ENTRYLEFT | LCD_AUTOSCROLL_ON)) != LCD_ENTRYLEFT;
+  if (forced_mode) {
+    l->hd.mode = LCD_ENTRYLEFT | LCD_AUTOSCROLL_OFF;
+    lcd_queue(l, COMMAND, LCD_ENTRYMODESET | l->hd.mode);
+  }
+
+  for (uint8_t row = 0; row < l->rows; row++) {
+    const uint8_t base = row * s->cols;
+    uint8_t col = 0;
+    while (col < s->cols) {
+      if (!lcd_shadow_is_dirty(s, base + col)) {
+        col++;
+        continue;
+      }
+
+      //Extend the run over dirty cells and short clean gaps (runs never cross rows)
+      uint8_t end = col;
+      for (uint8_t j = col + 1; j < s->cols && j <= end + LCD_SHADOW_GAP + 1; j++) {
+        if (lcd_shadow_is_dirty(s, base + j)) {
+          end = j;
+        }
+      }
+
+      lcd_queue_addr(l, col + hd44780_row_offsets[row & 0x03]);
+      for (; col <= end; col++) {
+        s->dirty[(base + col) >> 3] &= ~_BV((base + col) & 0x07);
+        lcd_queue(l, DATA, s->cells[base + col]);
+      }
+    }
+  }
+
+  if (forced_mode) {
+    l->hd.mode = mode;
+    lcd_queue(l, COMMAND, LCD_ENTRYMODESET | l->hd.mode);
+  }
+
+  //A visible cursor must end where the application left it
+  if ((l->hd.params & (LCD_CURSORON | LCD_BLINKON)) && s->pos < l->rows * s->cols) {
+    lcd_queue_addr(l, s->pos % s->cols + hd44780_row_offsets[(s->pos / s->cols) & 0x03]);
+  }
+
+  if (l->page) {
+    memcpy(l->page->front, s->cells, l->rows * s->cols);
+    l->page->known = true;
+  }
+  lcd_drain(l);
+}
+
+
+void lcd_attach_page(lcd_t *l, lcd_page_t *p, const uint8_t cols) {
+  lcd_attach_shadow(l, p ? &p->back : NULL, cols);
+  l->page = p;
+  if (p) {
+    p->known = false;
+  }
+}
+
+
+void lcd_present(lcd_t *l) {
+  lcd_page_t *p = l->page;
+  if (!p) {
+    return;
+  }
+
+  //Dirty cells are the ones that differ from the panel, not the ones written
+  const uint8_t size = l->rows * p->back.cols;
+  if (p->known) {
+    memset(p->back.dirty, 0, sizeof(p->back.dirty));
+    for (uint8_t i = 0; i < size; i++) {
+      if (p->back.cells[i] != p->front[i]) {
+        p->back.dirty[i >> 3] |= _BV(i & 0x07);
+      }
+    }
+  }
+
+  lcd_flush(l);
+}
+
+
+uint8_t lcd_try_print(lcd_t *l, char *string) {
+  uint8_t n = 0;
+  if (l->shadow) {
+    for (; string[n]; n++) {
+      lcd_shadow_put(l, string[n]);
+    }
+    return n;
+  }
+  while (string[n] && lcd_push(l, DATA, string[n])) {
+    n++;
+  }
+  lcd_poll(l);
+  return n;
+}
+
+
+bool lcd_try_print_ch(lcd_t *l, const char ch) {
+  if (l->shadow) {
+    lcd_shadow_put(l, ch);
+    return true;
+  }
+  const bool accepted = lcd_push(l, DATA, ch);
+  lcd_poll(l);
+  return accepted;
+}
+
+
+bool lcd_try_move_cursor(lcd_t *l, const uint8_t col, const uint8_t row) {
+  if (l->shadow) {
+    l->shadow->pos = row * l->shadow->cols + col;
+    return true;
   }
+  const bool accepted = lcd_push_addr(l, col + hd44780_row_offsets[row & 0x03]);
+  lcd_poll(l);
+  return accepted;
+}
+
+
+void lcd_attach_glyph_cache(lcd_t *l, lcd_glyph_cache_t *c) {
+  l->glyphs = c;
+  if (c) {
+    for (uint8_t i = 0; i < 8; i++) {
+      c->order[i] = 7 - i;  //Slot 0 is the first one to be used
+    }
+    c->valid = 0;
+  }
+}
+
+
+uint8_t lcd_glyph(lcd_t *l, const uint8_t charmap[8]) {
+  lcd_glyph_cache_t *c = l->glyphs;
+
+  //Look for the glyph, falling back to the least recently used slot
+  uint8_t pos = 7;
+  bool resident = false;
+  for (uint8_t i = 0; i < 8; i++) {
+    const uint8_t slot = c->order[i];
+    if ((c->valid & _BV(slot)) && memcmp(c->bitmap[slot], charmap, 8) == 0) {
+      pos = i;
+      resident = true;
+      break;
+    }
+  }
+
+  const uint8_t slot = c->order[pos];
+  if (!resident) {
+    memcpy(c->bitmap[slot], charmap, 8);
+    c->valid |= _BV(slot);
+    lcd_create_char(l, slot, (uint8_t *)charmap);
+  }
+
+  //Move the slot to the most recently used position
+  for (; pos > 0; pos--) {
+    c->order[pos] = c->order[pos - 1];
+  }
+  c->order[0] = slot;
+
+  return slot;
 }
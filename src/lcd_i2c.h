@@ -2,20 +2,111 @@
 #define LCD_I2C_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <i2c.h>
+#include "hd44780.h"
+
+/** Maximum number of cells a shadow framebuffer can hold (20x4 or 40x2) */
+#define LCD_SHADOW_CELLS 80
+
+/**
+ * @brief RAM copy of the display DDRAM.
+ *
+ * @details `cells` holds what the panel will show after the next
+ * lcd_flush() and `dirty` has one bit per cell that still has to be
+ * sent. Cells are stored row by row, `cols` cells per row.
+ */
+typedef struct {
+  uint8_t cols;
+  uint8_t pos;
+  uint8_t cells[LCD_SHADOW_CELLS];
+  uint8_t dirty[LCD_SHADOW_CELLS / 8];
+} lcd_shadow_t;
+
+/**
+ * @brief Double-buffered screen: a back page the application draws into
+ * and a copy of what the panel shows.
+ *
+ * @details `back` works as a shadow framebuffer. lcd_present() sends the
+ * cells where `back` differs from `front`, however many times they were
+ * rewritten meanwhile (e.g. a clear followed by a redraw).
+ */
+typedef struct {
+  lcd_shadow_t back;
+  uint8_t front[LCD_SHADOW_CELLS];
+  bool known;           /**< `front` matches the panel */
+} lcd_page_t;
+
+/**
+ * @brief Cache of the glyphs resident in the 8 CGRAM slots.
+ *
+ * @details Each slot keeps a copy of the bitmap uploaded to it, so a
+ * glyph is only reused when all its rows match. `order` lists the slots
+ * from most to least recently used and `valid` has one bit per slot
+ * holding a known glyph.
+ */
+typedef struct {
+  uint8_t bitmap[8][8];
+  uint8_t order[8];
+  uint8_t valid;
+} lcd_glyph_cache_t;
+
+/** Size in bytes of the per-display transmit buffer (4 bytes per LCD byte) */
+#ifndef LCD_TX_SIZE
+#define LCD_TX_SIZE 32
+#endif
+
+/** Number of LCD bytes the per-display transmit ring can hold (power of 2, max 128) */
+#ifndef LCD_RING_SIZE
+#define LCD_RING_SIZE 32
+#endif
+
+/** Time in ms the HD44780 needs after Vcc rises 2.7V before initialization */
+#define LCD_I2C_POWER_ON_MS 40
+
+/**
+ * @brief How the driver waits for slow commands (clear, return home).
+ * `LCD_PACE_DELAY` sleeps the worst case 2ms. `LCD_PACE_BUSY_FLAG` reads
+ * the HD44780 busy flag and requires the RW pin wired to the expander.
+ */
+typedef enum {
+  LCD_PACE_DELAY,
+  LCD_PACE_BUSY_FLAG
+} lcd_pacing_t;
+
+/**
+ * @brief Called while a blocking function waits for the bus, so that
+ * other I2C clients keep progressing (see lcd_set_yield()).
+ */
+typedef void (*lcd_yield_t)(void *ctx);
 
 /* A 'lcd_t' is an abstraction of an LCD display using the HD44780
- * controller through a PCF8574 I2C expander.
+ * controller through a PCF8574 I2C expander. The commands are built by
+ * the HD44780 core (hd44780.h); `hd` holds its state and the PCF8574
+ * transport.
  */
 
 typedef struct {
   const uint8_t i2c_address;
   const uint8_t rows;
-  uint8_t function;
-  uint8_t params;
-  uint8_t mode;
+  hd44780_t hd;
   volatile i2c_status_t i2c_comm;
   uint8_t r_buffer;
+  uint8_t bf_step;
+  lcd_shadow_t *shadow;
+  lcd_page_t *page;
+  lcd_glyph_cache_t *glyphs;
+  uint8_t tx[LCD_TX_SIZE];
+  uint8_t ring[LCD_RING_SIZE];
+  uint8_t ring_rs[LCD_RING_SIZE / 8];
+  volatile uint8_t ring_head;
+  volatile uint8_t ring_tail;
+  lcd_pacing_t pacing;
+  volatile bool pending;
+  uint8_t init_state;
+  uint16_t init_deadline;
+  lcd_yield_t yield;
+  void *yield_ctx;
 } lcd_t;
 
 /**
@@ -53,10 +144,69 @@ lcd_t lcd_constructor(const uint8_t i2c_address, const uint8_t rows);
 void lcd_init(lcd_t *l);
 
 
+/**
+ * @brief Starts the asynchronous initialization of the LCD.
+ * Must be called after the 'i2c' module has been initialized. The
+ * initialization is then carried out by lcd_init_step(), so the rest of
+ * the firmware can initialize while the LCD waits for its timings.
+ *
+ * @param l The LCD struct variable.
+ */
+void lcd_init_start(lcd_t *l);
+
+
+/**
+ * @brief Advances the asynchronous initialization of the LCD.
+ * Never blocks. Must be called repeatedly until it returns true; the
+ * first step does not happen before `now_ms` reaches `LCD_I2C_POWER_ON_MS`.
+ *
+ * @param l The LCD struct variable.
+ * @param now_ms Current time in ms since power on (wraps around)
+ * @return true once the LCD is initialized and ready to use
+ */
+bool lcd_init_step(lcd_t *l, const uint16_t now_ms);
+
+
+/**
+ * @brief Selects how the driver waits for slow commands.
+ * In `LCD_PACE_BUSY_FLAG` mode, a slow command leaves the LCD pending and
+ * the next transfer to the same LCD first polls the busy flag until the
+ * controller reports it has finished.
+ * @param l Pointer to the LCD object
+ * @param pacing The pacing mode
+ */
+void lcd_set_pacing(lcd_t *l, const lcd_pacing_t pacing);
+
+
+/**
+ * @brief Sets the function called while a blocking function of this LCD
+ * waits for its transmit ring to drain, e.g. lcd_bus_yield() to let the
+ * other panels on the bus progress during a long `lcd_print`. When the
+ * function also polls this LCD, as lcd_bus_yield() does, the LCD is not
+ * polled again on its own, so it keeps its one transaction per round.
+ * @param l Pointer to the LCD object
+ * @param yield The function, or NULL to just spin (default)
+ * @param ctx Argument passed to `yield`
+ */
+void lcd_set_yield(lcd_t *l, lcd_yield_t yield, void *ctx);
+
+
+/**
+ * @brief Checks, without blocking, whether the LCD can accept a new command.
+ * While a slow command is pending in `LCD_PACE_BUSY_FLAG` mode, every call
+ * advances the busy flag polling (one asynchronous read at a time).
+ * @param l Pointer to the LCD object
+ * @return true if no command is pending
+ */
+bool lcd_ready(lcd_t *l);
+
+
 /**
  * @brief Clears the LCD display.
  * @param l Pointer to the LCD object
- * @param blocking `true`: the function blocks during 2ms. `false`: Just sends the command
+ * @param blocking `true`: the function blocks until the command has finished
+ * (2ms, or until the busy flag clears in `LCD_PACE_BUSY_FLAG` mode).
+ * `false`: Just sends the command
  */
 void lcd_clear(lcd_t *l, const bool blocking);
 
@@ -65,13 +215,17 @@ void lcd_clear(lcd_t *l, const bool blocking);
  * @brief Returns both display and cursor to the first 
  * position (address 0).
  * @param l Pointer to the LCD object
- * @param blocking `true`: the function will block during 2ms. `false`: Just sends the command.
+ * @param blocking `true`: the function will block until the command has finished
+ * (2ms, or until the busy flag clears in `LCD_PACE_BUSY_FLAG` mode).
+ * `false`: Just sends the command.
  */
 void lcd_return_home(lcd_t *l, const bool blocking);
 
 
 /**
  * @brief Request the LCD the busy flag status.
+ * Never blocks: the transfers of the read are queued while the i2c queue
+ * has room, and a later call queues the rest.
  * 
  * @param l Pointer to the LCD object
  */
@@ -189,6 +343,8 @@ void lcd_create_char(lcd_t *l, uint8_t location, uint8_t charmap[8]);
 
 /**
  * @brief Move the LCD cursor to the desired position
+ * The driver tracks the DDRAM address counter, so no command is sent if
+ * the cursor is already there (e.g. right after printing up to it).
  * @param l Pointer to the LCD object
  * @param col The column
  * @param row The row
@@ -205,12 +361,165 @@ void lcd_print_ch(lcd_t *l, const char ch);
 
 /**
  * @brief Prints a string to the LCD
- * The function will be blocking as soon as the i2c queue will be full.
- * Better to use the `lcd_print_ch` in a prothothreads environment or
- * increase the i2c queue array size.
+ * The string is packed into i2c transactions of `LCD_TX_SIZE / 4`
+ * characters each. The function blocks until the whole string has been
+ * handed to the i2c queue. Use `lcd_try_print` to never block.
  * @param l Pointer to the LCD object to send the string
  * @param string The string object to be sent
  */
 void lcd_print(lcd_t *l, char *string);
 
+
+/**
+ * @brief Prints a formatted string to the LCD
+ * Characters are written straight to the display path (shadow or
+ * transmit ring), without an intermediate buffer nor `vsnprintf`.
+ * Supported conversions: `%d %u %x %s %S %c %%` (`%S` is a string
+ * stored in flash, as in avr-libc), with an optional `l`
+ * length modifier (32 bit) for `d`, `u`, `x` and `f`, a field width,
+ * and the `0` (zero padding) or `-` (left align) flag.
+ * `%.Nf` prints a fixed-point integer holding the value times 10^N:
+ * `lcd_printf(l, "%.2f", 1234)` prints `12.34`. N is at most 9 (larger
+ * precisions print 9 decimals).
+ * @param l Pointer to the LCD object
+ * @param format The format string
+ */
+void lcd_printf(lcd_t *l, char *format, ...);
+
+
+/**
+ * @brief Prints a string stored in flash (`PSTR` or `PROGMEM`) to the LCD
+ * The string is read with `pgm_read_byte` and never copied to SRAM.
+ * @param l Pointer to the LCD object
+ * @param string The string, in program memory
+ */
+void lcd_print_P(lcd_t *l, const char *string);
+
+
+/**
+ * @brief Prints a formatted string whose format is stored in flash
+ * Same conversions as `lcd_printf`.
+ * @param l Pointer to the LCD object
+ * @param format The format string, in program memory
+ */
+void lcd_printf_P(lcd_t *l, const char *format, ...);
+
+
+/**
+ * @brief Moves pending bytes from the transmit ring of the LCD to the
+ * i2c queue. Never blocks: it does nothing while the previous transaction
+ * of this LCD is running, a slow command is pending or the i2c queue is
+ * full. Must be called periodically (main loop or protothread) when the
+ * `lcd_try_*` functions are used.
+ * @param l Pointer to the LCD object
+ * @return true if the transmit ring is empty
+ */
+bool lcd_poll(lcd_t *l);
+
+
+/**
+ * @brief Prints as much of a string as fits in the transmit ring without blocking.
+ * @param l Pointer to the LCD object
+ * @param string The string to be printed
+ * @return The number of characters accepted. The caller retries the rest later.
+ */
+uint8_t lcd_try_print(lcd_t *l, char *string);
+
+
+/**
+ * @brief Prints a character if it fits in the transmit ring without blocking.
+ * @param l Pointer to the LCD object
+ * @param ch The character to be printed
+ * @return true if the character was accepted
+ */
+bool lcd_try_print_ch(lcd_t *l, const char ch);
+
+
+/**
+ * @brief Moves the cursor if the command fits in the transmit ring without blocking.
+ * @param l Pointer to the LCD object
+ * @param col The column
+ * @param row The row
+ * @return true if the command was accepted
+ */
+bool lcd_try_move_cursor(lcd_t *l, const uint8_t col, const uint8_t row);
+
+
+/**
+ * @brief Attaches a shadow framebuffer to the LCD.
+ * While a shadow is attached, `lcd_print`, `lcd_print_ch`, `lcd_move_cursor`,
+ * `lcd_clear` and `lcd_return_home` only update the shadow, and nothing
+ * reaches the panel until lcd_flush() is called. Writing a character
+ * equal to the one already in the cell does not mark it dirty.
+ * The whole shadow is filled with blanks and marked dirty, so the first
+ * flush rewrites the full panel. Display shift (`lcd_scroll_*` and
+ * autoscroll) is not modelled by the shadow.
+ *
+ * @param l Pointer to the LCD object
+ * @param s The shadow storage, or NULL to detach the current one
+ * @param cols Number of columns of the display. `cols * rows` must not
+ * exceed `LCD_SHADOW_CELLS`.
+ */
+void lcd_attach_shadow(lcd_t *l, lcd_shadow_t *s, const uint8_t cols);
+
+
+/**
+ * @brief Sends the dirty cells of the shadow to the LCD.
+ * Changed cells are grouped into runs inside each row and every run
+ * costs a single `SETDDRAMADDR` command plus its characters.
+ * Does nothing if no shadow is attached.
+ * @param l Pointer to the LCD object
+ */
+void lcd_flush(lcd_t *l);
+
+
+/**
+ * @brief Attaches a double-buffered screen to the LCD.
+ * Its back page becomes the shadow framebuffer, so every drawing
+ * function, `lcd_clear` included, only updates the back page until
+ * lcd_present() is called. No slow clear command is ever sent.
+ *
+ * @param l Pointer to the LCD object
+ * @param p The page storage, or NULL to detach the current one
+ * @param cols Number of columns of the display. `cols * rows` must not
+ * exceed `LCD_SHADOW_CELLS`.
+ */
+void lcd_attach_page(lcd_t *l, lcd_page_t *p, const uint8_t cols);
+
+
+/**
+ * @brief Shows the back page: the cells that differ from what the panel
+ * shows are sent in one burst, grouped in runs as `lcd_flush` does. The
+ * first call after attaching rewrites the whole panel.
+ * Does nothing if no page is attached.
+ * @param l Pointer to the LCD object
+ */
+void lcd_present(lcd_t *l);
+
+
+/**
+ * @brief Attaches a CGRAM glyph cache to the LCD.
+ * All slots start empty, so each glyph is uploaded the first time it
+ * is requested. `lcd_create_char` bypasses the cache: do not mix both.
+ *
+ * @param l Pointer to the LCD object
+ * @param c The cache storage, or NULL to detach the current one
+ */
+void lcd_attach_glyph_cache(lcd_t *l, lcd_glyph_cache_t *c);
+
+
+/**
+ * @brief Gets the CGRAM slot holding a glyph, uploading it if needed.
+ * A glyph already resident is not sent again. Otherwise the least
+ * recently used slot is overwritten, which also changes every cell
+ * currently showing that slot. As with `lcd_create_char`, the cursor
+ * must be moved after an upload unless a shadow framebuffer is attached.
+ * Requires an attached glyph cache.
+ *
+ * @param l Pointer to the LCD object
+ * @param charmap The 5x8px bitmap of the glyph
+ * @return The character code (0-7) to print the glyph
+ */
+uint8_t lcd_glyph(lcd_t *l, const uint8_t charmap[8]);
+
 #endif
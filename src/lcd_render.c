@@ -0,0 +1,270 @@
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+#include "lcd_render.h"
+
+
+//Widest run of cells a bar redraws at once (a 40x2 display row)
+#define LCD_BAR_MAX 40
+
+//ROM character with all the pixels lit (A00 and A02 character sets)
+#define LCD_FULL_BLOCK 0xFF
+
+/*
+ * Codes 8-15 also show CGRAM slots 0-7, and unlike code 0 they can be
+ * part of a string.
+ */
+#define LCD_SLOT_CODE(slot) ((slot) + 8)
+
+
+/*
+ * Cells of the big digits, row by row: 'U' upper half block, 'L' lower
+ * half block, 'D' both of them, 'F' full block and ' ' blank.
+ */
+static const char big_digits_2[10][6] PROGMEM = {
+  "FUFFLF", "UF LFL", "DDFFLL", "DDFLLF", "FLF  F",
+  "FDDLLF", "FDDFLF", "UUF  F", "FDFFLF", "FDFLLF"
+};
+
+static const char big_digits_3[10][9] PROGMEM = {
+  "FUFF FFLF", "UF  F LFL", "UUFFUUFLL", "UUF UFLLF", "F FFUF  F",
+  "FUUUUFLLF", "FUUFUFFLF", "UUF  F  F", "FUFFUFFLF", "FUFUUFLLF"
+};
+
+
+/*
+ * Uploads, if needed, a glyph lighting some whole pixel rows.
+ * @param l The LCD object
+ * @param rows Bit n set lights pixel row n (0 is the top one)
+ * @return The character code showing the glyph
+ */
+static char lcd_rows_glyph(lcd_t *l, uint8_t rows) {
+  uint8_t charmap[8];
+
+  for (uint8_t i = 0; i < 8; i++) {
+    charmap[i] = (rows & _BV(i)) ? 0x1F : 0x00;
+  }
+  return LCD_SLOT_CODE(lcd_glyph(l, charmap));
+}
+
+
+/*
+ * Uploads, if needed, a glyph lighting some whole pixel columns.
+ * @param l The LCD object
+ * @param cols Number of columns lit, from the left (1 to 4)
+ * @return The character code showing the glyph
+ */
+static char lcd_cols_glyph(lcd_t *l, uint8_t cols) {
+  uint8_t charmap[8];
+
+  memset(charmap, 0x1F & ~(0x1F >> cols), sizeof(charmap));
+  return LCD_SLOT_CODE(lcd_glyph(l, charmap));
+}
+
+
+void lcd_big_init(lcd_big_t *b, uint8_t col, uint8_t row, uint8_t rows, uint8_t digits) {
+  b->col = col;
+  b->row = row;
+  b->rows = (rows == 3) ? 3 : 2;
+  b->digits = (digits > LCD_BIG_DIGITS) ? LCD_BIG_DIGITS : digits;
+  memset(b->shown, '\0', sizeof(b->shown));
+}
+
+
+void lcd_big_print(lcd_t *l, lcd_big_t *b, const char *text) {
+  char upper = 0, lower = 0, both = 0;
+  char cells[5];
+  bool end = false;
+
+  cells[4] = '\0';
+  for (uint8_t i = 0; i < b->digits; i++) {
+    char digit = end ? ' ' : text[i];
+    if (digit == '\0') {
+      end = true;
+      digit = ' ';
+    } else if (digit < '0' || digit > '9') {
+      digit = ' ';
+    }
+    if (digit == b->shown[i])
+      continue;
+    b->shown[i] = digit;
+
+    //All glyphs are uploaded before moving the cursor
+    if (!upper) {
+      upper = lcd_rows_glyph(l, 0x03);
+      lower = lcd_rows_glyph(l, 0xC0);
+      both = lcd_rows_glyph(l, 0xC3);
+    }
+
+    const char *pattern = (b->rows == 3) ?
+      big_digits_3[digit - '0'] : big_digits_2[digit - '0'];
+    for (uint8_t r = 0; r < b->rows; r++) {
+      for (uint8_t c = 0; c < 3; c++) {
+        const char cell = (digit == ' ') ? ' ' : pgm_read_byte(&pattern[r * 3 + c]);
+        cells[c] = (cell == 'U') ? upper :
+                   (cell == 'L') ? lower :
+                   (cell == 'D') ? both :
+                   (cell == 'F') ? (char)LCD_FULL_BLOCK : ' ';
+      }
+      //Gap to the next digit, only when there is one
+      cells[3] = (i + 1 < b->digits) ? ' ' : '\0';
+      lcd_move_cursor(l, b->col + i * 4, b->row + r);
+      lcd_print(l, cells);
+    }
+  }
+}
+
+
+void lcd_big_number(lcd_t *l, lcd_big_t *b, uint16_t value) {
+  char text[LCD_BIG_DIGITS + 1];
+  uint8_t i = b->digits;
+
+  text[i] = '\0';
+  do {
+    text[--i] = '0' + value % 10;
+    value /= 10;
+  } while (value && i);
+  while (i) {
+    text[--i] = ' ';
+  }
+  lcd_big_print(l, b, text);
+}
+
+
+void lcd_bar_init(lcd_bar_t *b, uint8_t col, uint8_t row, uint8_t len, bool vertical) {
+  b->col = col;
+  b->row = row;
+  b->len = (!vertical && len > LCD_BAR_MAX) ? LCD_BAR_MAX : len;
+  b->vertical = vertical;
+  b->shown = 0xFF;
+}
+
+
+/*
+ * Pixels of a bar cell for a level, from 0 (blank) to `per_cell` (full).
+ */
+static uint8_t lcd_bar_fill(uint8_t level, uint8_t cell, uint8_t per_cell) {
+  const uint8_t start = cell * per_cell;
+
+  if (level <= start)
+    return 0;
+  if (level - start >= per_cell)
+    return per_cell;
+  return level - start;
+}
+
+
+void lcd_bar_set(lcd_t *l, lcd_bar_t *b, uint8_t level) {
+  const uint8_t per_cell = b->vertical ? 8 : 5;
+  const uint8_t max = b->len * per_cell;
+  const uint8_t shown = b->shown;
+  char partial = ' ';
+
+  if (level > max)
+    level = max;
+  if (level == shown)
+    return;
+  b->shown = level;
+
+  //At most one cell is partially filled: upload its glyph first
+  const uint8_t fill = level % per_cell;
+  if (fill) {
+    partial = b->vertical ? lcd_rows_glyph(l, 0xFF << (8 - fill)) : lcd_cols_glyph(l, fill);
+  }
+
+  if (b->vertical) {
+    //One cell per row, bottom to top: only the rows that change
+    for (uint8_t i = 0; i < b->len; i++) {
+      const uint8_t now = lcd_bar_fill(level, i, 8);
+      if (shown != 0xFF && now == lcd_bar_fill(shown, i, 8))
+        continue;
+      lcd_move_cursor(l, b->col, b->row - i);
+      lcd_print_ch(l, (now == 8) ? (char)LCD_FULL_BLOCK : now ? partial : ' ');
+    }
+    return;
+  }
+
+  //The cells that change are contiguous: one move and one print
+  char run[LCD_BAR_MAX + 1];
+  uint8_t first = 0, last = b->len;
+  if (shown != 0xFF) {
+    while (first < b->len && lcd_bar_fill(level, first, 5) == lcd_bar_fill(shown, first, 5))
+      first++;
+    while (last > first && lcd_bar_fill(level, last - 1, 5) == lcd_bar_fill(shown, last - 1, 5))
+      last--;
+  }
+
+  uint8_t n = 0;
+  for (uint8_t i = first; i < last; i++) {
+    const uint8_t now = lcd_bar_fill(level, i, 5);
+    run[n++] = (now == 5) ? (char)LCD_FULL_BLOCK : now ? partial : ' ';
+  }
+  run[n] = '\0';
+  if (n) {
+    lcd_move_cursor(l, b->col + first, b->row);
+    lcd_print(l, run);
+  }
+}
+
+
+void lcd_marquee_init(lcd_marquee_t *m, uint8_t col, uint8_t row, uint8_t width, uint8_t period) {
+  m->col = col;
+  m->row = row;
+  m->width = width;
+  m->period = period ? period : 1;
+  lcd_marquee_set_text(m, "");
+}
+
+
+void lcd_marquee_set_text(lcd_marquee_t *m, const char *text) {
+  m->text = text;
+  m->progmem = false;
+  m->len = strlen(text);
+  m->offset = 0;
+  m->ticks = 0;
+  m->drawn = 0;
+}
+
+
+void lcd_marquee_set_text_P(lcd_marquee_t *m, const char *text) {
+  lcd_marquee_set_text(m, "");
+  m->text = text;
+  m->progmem = true;
+  m->len = strlen_P(text);
+}
+
+
+/*
+ * Character of a window cell: the text repeats, LCD_MARQUEE_GAP blanks
+ * apart, unless it fits in the window.
+ */
+static char lcd_marquee_char(const lcd_marquee_t *m, uint8_t cell) {
+  uint16_t i = m->offset + cell;
+
+  if (m->len > m->width) {
+    i %= m->len + LCD_MARQUEE_GAP;
+  }
+  if (i >= m->len)
+    return ' ';
+  return m->progmem ? pgm_read_byte(&m->text[i]) : m->text[i];
+}
+
+
+bool lcd_marquee_tick(lcd_t *l, lcd_marquee_t *m) {
+  //Ticks are counted once the previous window is on its way
+  if (m->len > m->width && m->drawn == m->width && ++m->ticks == m->period) {
+    m->ticks = 0;
+    m->offset = (m->offset + 1) % (m->len + LCD_MARQUEE_GAP);
+    m->drawn = 0;
+  }
+
+  //Moves are elided while the address counter is already there
+  while (m->drawn < m->width) {
+    if (!lcd_try_move_cursor(l, m->col + m->drawn, m->row) ||
+        !lcd_try_print_ch(l, lcd_marquee_char(m, m->drawn))) {
+      return false;
+    }
+    m->drawn++;
+  }
+  return true;
+}
@@ -0,0 +1,179 @@
+/** @file lcd_render.h
+ *  @brief Big numerals, bar graphs and marquees for `lcd_i2c` displays.
+ *
+ *  Numerals and bars are drawn with custom characters obtained from the glyph cache
+ *  (lcd_attach_glyph_cache() is required), so each glyph is uploaded
+ *  once and then stays resident. Every widget remembers what it shows
+ *  and only the cells whose contents change are sent again, e.g. a bar
+ *  moving one pixel costs a cursor move and one character.
+ *
+ *  Full cells use the ROM full block (code 0xFF) and custom glyphs are
+ *  printed as codes 8-15, so they can be part of a string. CGRAM only
+ *  holds 8 glyphs: big numerals use 3, a horizontal bar 4 and a
+ *  vertical bar 7. Widgets on the same screen must not need more
+ *  than 8 different glyphs, otherwise the cache would replace glyphs
+ *  still shown.
+ */
+
+#ifndef LCD_RENDER_H
+#define LCD_RENDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lcd_i2c.h"
+
+/** Blanks between the end of a marquee text and its next repetition */
+#ifndef LCD_MARQUEE_GAP
+#define LCD_MARQUEE_GAP 3
+#endif
+
+/** Maximum number of digits of a big numeral (4 columns each) */
+#define LCD_BIG_DIGITS 5
+
+/**
+ * @brief A big numeral, 3 columns wide per digit plus a blank column.
+ */
+typedef struct {
+  uint8_t col;                  /**< Leftmost column */
+  uint8_t row;                  /**< Top row */
+  uint8_t rows;                 /**< Height: 2 or 3 rows */
+  uint8_t digits;               /**< Number of digits */
+  char shown[LCD_BIG_DIGITS];   /**< Digits on the display ('\0' if unknown) */
+} lcd_big_t;
+
+/**
+ * @brief A bar graph with a resolution of one pixel: 5 levels per cell
+ * when horizontal (growing to the right), 8 when vertical (growing up).
+ */
+typedef struct {
+  uint8_t col;                  /**< Leftmost column */
+  uint8_t row;                  /**< Row; bottom row of a vertical bar */
+  uint8_t len;                  /**< Length in cells */
+  bool vertical;
+  uint8_t shown;                /**< Level on the display (0xFF if unknown) */
+} lcd_bar_t;
+
+/**
+ * @brief A text scrolling to the left inside a window of one row.
+ */
+typedef struct {
+  const char *text;
+  bool progmem;                 /**< `text` is in flash */
+  uint16_t len;                 /**< Length of `text` */
+  uint16_t offset;              /**< Text position shown in the first cell */
+  uint8_t col;                  /**< Leftmost column of the window */
+  uint8_t row;
+  uint8_t width;                /**< Window width in cells */
+  uint8_t period;               /**< Ticks per step */
+  uint8_t ticks;                /**< Ticks since the last step */
+  uint8_t drawn;                /**< Cells of the window already sent */
+} lcd_marquee_t;
+
+
+/**
+ * @brief Places a big numeral. Nothing is drawn until lcd_big_print().
+ *
+ * @param b The numeral
+ * @param col Leftmost column
+ * @param row Top row
+ * @param rows Height: 2 or 3 rows
+ * @param digits Number of digits, up to LCD_BIG_DIGITS
+ */
+void lcd_big_init(lcd_big_t *b, uint8_t col, uint8_t row, uint8_t rows, uint8_t digits);
+
+
+/**
+ * @brief Shows a string of digits ('0'-'9', anything else is blank),
+ * left aligned. Only the digits that change are drawn.
+ *
+ * @param l Pointer to the LCD object
+ * @param b The numeral
+ * @param text The digits
+ */
+void lcd_big_print(lcd_t *l, lcd_big_t *b, const char *text);
+
+
+/**
+ * @brief Shows a number, right aligned with leading blanks.
+ * Only the digits that change are drawn.
+ *
+ * @param l Pointer to the LCD object
+ * @param b The numeral
+ * @param value The number
+ */
+void lcd_big_number(lcd_t *l, lcd_big_t *b, uint16_t value);
+
+
+/**
+ * @brief Places a bar graph. Nothing is drawn until lcd_bar_set().
+ *
+ * @param b The bar
+ * @param col Leftmost column
+ * @param row Row (bottom row if vertical)
+ * @param len Length in cells
+ * @param vertical Grows upwards from `row` instead of rightwards from `col`
+ */
+void lcd_bar_init(lcd_bar_t *b, uint8_t col, uint8_t row, uint8_t len, bool vertical);
+
+
+/**
+ * @brief Sets the level of a bar graph. Only the cells that change are
+ * drawn.
+ *
+ * @param l Pointer to the LCD object
+ * @param b The bar
+ * @param level From 0 to `len * 5` (horizontal) or `len * 8` (vertical)
+ */
+void lcd_bar_set(lcd_t *l, lcd_bar_t *b, uint8_t level);
+
+
+
+/**
+ * @brief Places a marquee. Nothing is drawn until a text is set.
+ *
+ * @param m The marquee
+ * @param col Leftmost column of the window
+ * @param row Row of the window
+ * @param width Window width in cells
+ * @param period Ticks between steps of one character (1 or more)
+ */
+void lcd_marquee_init(lcd_marquee_t *m, uint8_t col, uint8_t row, uint8_t width, uint8_t period);
+
+
+/**
+ * @brief Sets the text of a marquee, shown from its start at the next
+ * tick. A text that fits in the window is drawn once and does not move.
+ * The text is not copied and must stay valid.
+ *
+ * @param m The marquee
+ * @param text The text, in SRAM
+ */
+void lcd_marquee_set_text(lcd_marquee_t *m, const char *text);
+
+
+/**
+ * @brief Same as lcd_marquee_set_text() with a text in flash
+ * (e.g. `PSTR("...")`).
+ */
+void lcd_marquee_set_text_P(lcd_marquee_t *m, const char *text);
+
+
+/**
+ * @brief Advances a marquee. Call it from a periodic tick (e.g. a timer
+ * flag checked by the main loop): every `period` ticks the text moves
+ * one character and the window is rewritten. Only the window is
+ * written, the rest of the row and the display shift are untouched.
+ *
+ * @details Never blocks: the window goes through the `lcd_try_*`
+ * functions, and when the transmit ring is full drawing resumes at the
+ * next tick. The `period` ticks of a step are counted once the previous
+ * window has been queued.
+ * `lcd_poll` must be called periodically.
+ *
+ * @param l Pointer to the LCD object
+ * @param m The marquee
+ * @return true once the whole window has been queued
+ */
+bool lcd_marquee_tick(lcd_t *l, lcd_marquee_t *m);
+
+#endif
@@ -1,81 +1,194 @@
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 #include "motor.h"
 
 
-/*
- * Configure port and pin corresponding to motor driver.
- * enable, step, and direction
- */
-#define ENA_PRT  PORTB
-#define ENA_PIN  4
-#define STP_PRT  PORTB
-#define STP_PIN  3
-#define DIR_PRT  PORTB
-#define DIR_PIN  2
-
-
 /* Macros to get control registers of port */
-#define PORT(x) (x)
-#define DDR(x)  (*(&(x)-1))   // consider DDRy = PORTy - 1
-#define PIN(x)  (*(&(x)-2))   // consider PINy = PORTy - 2
+#define PORT(x) (*(x))
+#define DDR(x)  (*((x)-1))   // consider DDRy = PORTy - 1
+
+
+motor_t motor_create(volatile uint8_t *ena_port, uint8_t ena_pin,
+                     volatile uint8_t *stp_port, uint8_t stp_pin,
+                     volatile uint8_t *dir_port, uint8_t dir_pin) {
+  motor_t m;
+
+  m.ena_port = ena_port;
+  m.ena = _BV(ena_pin);
+  m.stp_port = stp_port;
+  m.stp = _BV(stp_pin);
+  m.dir_port = dir_port;
+  m.dir = _BV(dir_pin);
+  motor_setup(&m);
+  return m;
+}
 
 
 /* 
- * Setup motor module.
- * Post: motor is prepared; motor disabled; direction wind  
+ * Setup motor pins.
+ * Post: pins are outputs; step pin low; direction wind
  */
-void motor_setup(void) {
+void motor_setup(const motor_t *m) {
   /* config ports as output */
-  DDR(ENA_PRT) |= _BV(ENA_PIN);
-  DDR(STP_PRT) |= _BV(STP_PIN);
-  DDR(DIR_PRT) |= _BV(DIR_PIN);
+  DDR(m->ena_port) |= m->ena;
+  DDR(m->stp_port) |= m->stp;
+  DDR(m->dir_port) |= m->dir;
   /* set ports default value */
-  PORT(ENA_PRT) &= ~_BV(ENA_PIN);    // motor disabled
-  PORT(STP_PRT) &= ~_BV(STP_PIN);    // step pin low
-  if (motor_wind == 0)               // provision for configuring dir
-    PORT(DIR_PRT) &= ~_BV(DIR_PIN);
-  else
-    PORT(DIR_PRT) |=  _BV(DIR_PIN);
+  PORT(m->ena_port) &= ~m->ena;
+  PORT(m->stp_port) &= ~m->stp;      // step pin low
+  motor_set_dir(m, motor_wind);
 }
 
-/* Order one step. Motor needs to be enabled */
-void motor_step(void) {
-  /* pulse on step pin */
-  PORT(STP_PRT) |= _BV(STP_PIN);
+
+/*
+ * Steps of motor_move() are generated by the Timer1 compare interrupt in
+ * CTC mode: one step every OCR1A + 1 timer ticks. Prescaler 8 (0.5us
+ * ticks at 16MHz) covers down to 31 steps/s, prescaler 64 down to
+ * MOTOR_MIN_RATE.
+ */
+#define MOTOR_TIMER_FAST  (_BV(WGM12) | _BV(CS11))
+#define MOTOR_TIMER_SLOW  (_BV(WGM12) | _BV(CS11) | _BV(CS10))
+
+static const motor_t *motor_axes[MOTOR_AXES];   // motors of the current move
+static motor_dda_t motor_dda;
+static volatile uint16_t motor_left;   // ticks left of the current move
+
+/*
+ * Ramped moves: the interrupt loads the interval computed on the previous
+ * step into OCR1A right after the step, then computes the next one, so
+ * the timer is never reprogrammed late.
+ */
+enum {
+  MOTOR_CONSTANT,                      // constant rate
+  MOTOR_TRAPEZOID,                     // motor_set_accel()
+  MOTOR_SCURVE                         // motor_set_scurve()
+};
+
+static motor_accel_t motor_accel;
+static const motor_scurve_t *motor_scurve;
+static uint8_t motor_profile;          // of the following moves
+static uint8_t motor_ramping;          // of the current move
+static motor_ramp_t motor_ramp;
+static motor_scurve_move_t motor_scurve_move;
+static uint16_t motor_next;            // interval after the next step
+
+
+/*
+ * Every tick steps the axes chosen by the DDA, with a single pulse for
+ * all of them.
+ */
+ISR(TIMER1_COMPA_vect) {
+  const uint8_t mask = motor_dda_next(&motor_dda);
+
+  for (uint8_t i = 0; i < motor_dda.axes; i++) {
+    if (mask & _BV(i))
+      *motor_axes[i]->stp_port |= motor_axes[i]->stp;
+  }
   _delay_us(2);
-  PORT(STP_PRT) &= ~_BV(STP_PIN);
+  for (uint8_t i = 0; i < motor_dda.axes; i++) {
+    *motor_axes[i]->stp_port &= ~motor_axes[i]->stp;
+  }
+
+  if (--motor_left == 0) {
+    TCCR1B = 0;                  // stop the timer
+    TIMSK1 &= ~_BV(OCIE1A);
+  } else if (motor_ramping == MOTOR_TRAPEZOID) {
+    OCR1A = motor_next - 1;
+    motor_next = motor_ramp_next(&motor_ramp);
+  } else if (motor_ramping == MOTOR_SCURVE) {
+    OCR1A = motor_next - 1;
+    motor_next = motor_scurve_next(&motor_scurve_move);
+  }
 }
 
-  
-/* Set a given turning direction */
-void motor_set_dir(motor_dir_t d) {
-  if (d == 0)               // provision for configuring dir
-    PORT(DIR_PRT) &= ~_BV(DIR_PIN);
-  else
-    PORT(DIR_PRT) |=  _BV(DIR_PIN);
+
+void motor_use_accel(const motor_accel_t *a) {
+  motor_profile = a ? MOTOR_TRAPEZOID : MOTOR_CONSTANT;
+  if (a)
+    motor_accel = *a;
 }
 
 
-/* Reverse the turning direction */
-void motor_reverse(void) {
-  PIN(DIR_PRT) |= _BV(DIR_PIN);
+void motor_set_scurve(const motor_scurve_t *s) {
+  motor_scurve = s;
+  motor_profile = s ? MOTOR_SCURVE : MOTOR_CONSTANT;
 }
 
 
 /*
- * Enable and disable motor.  
- * Motor is power feeded only while enabled, thus braking torque 
- * only effective while enabled. Disabling avoids power consumption.
+ * Starts the timer for a move of `steps` ticks planned in motor_dda.
  */
-void motor_enable(void) {
-  PORT(ENA_PRT) &= ~_BV(ENA_PIN);
+static void motor_run(uint16_t steps, uint16_t steps_per_sec) {
+  if (steps == 0 || steps_per_sec < MOTOR_MIN_RATE)
+    return;
+
+  uint32_t ticks = F_CPU / 8 / steps_per_sec;
+  uint8_t clock = MOTOR_TIMER_FAST;
+  if (ticks > 0x10000UL) {
+    ticks = F_CPU / 64 / steps_per_sec;
+    clock = MOTOR_TIMER_SLOW;
+  }
+
+  motor_ramping = (clock == MOTOR_TIMER_FAST) ? motor_profile : MOTOR_CONSTANT;
+  if (motor_ramping == MOTOR_TRAPEZOID) {
+    ticks = motor_ramp_start(&motor_ramp, &motor_accel, steps, steps_per_sec);
+    motor_next = motor_ramp_next(&motor_ramp);
+  } else if (motor_ramping == MOTOR_SCURVE) {
+    ticks = motor_scurve_start(&motor_scurve_move, motor_scurve, steps, steps_per_sec);
+    motor_next = motor_scurve_next(&motor_scurve_move);
+  }
+
+  motor_left = steps;
+  TCCR1A = 0;
+  OCR1A = ticks - 1;
+  TCNT1 = 0;
+  TIFR1 = _BV(OCF1A);            // discard a stale compare match
+  TIMSK1 |= _BV(OCIE1A);
+  TCCR1B = clock;                // first step one period from now
 }
 
 
-void motor_disable(void) {
-  PORT(ENA_PRT) |= _BV(ENA_PIN);
-}  
+void motor_move(const motor_t *m, uint16_t steps, uint16_t steps_per_sec) {
+  motor_stop();
+  motor_axes[0] = m;
+  motor_run(motor_dda_start(&motor_dda, &steps, 1), steps_per_sec);
+}
+
 
+void motor_line(const motor_t *const m[], const int16_t delta[], uint8_t axes,
+                uint16_t steps_per_sec) {
+  uint16_t steps[MOTOR_AXES];
+
+  motor_stop();
+  if (axes > MOTOR_AXES)
+    axes = MOTOR_AXES;
+  for (uint8_t i = 0; i < axes; i++) {
+    motor_axes[i] = m[i];
+    motor_set_dir(m[i], (delta[i] < 0) ? motor_unwind : motor_wind);
+    steps[i] = (delta[i] < 0) ? -(int32_t)delta[i] : delta[i];
+  }
+  motor_run(motor_dda_start(&motor_dda, steps, axes), steps_per_sec);
+}
 
 
+bool motor_is_busy(void) {
+  return motor_remaining() != 0;
+}
+
+
+uint16_t motor_remaining(void) {
+  uint16_t left;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    left = motor_left;
+  }
+  return left;
+}
+
+
+void motor_stop(void) {
+  TIMSK1 &= ~_BV(OCIE1A);
+  TCCR1B = 0;
+  motor_left = 0;
+}
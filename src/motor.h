@@ -1,18 +1,42 @@
 /** @file motor.h
  *  @brief Abstraction of a stepper motor.
  *  
- *  Implements the functions to control a stepper motor
- *  using three pins (Enable, Direction and Steps) that
- *  are defined as constants inside the module to reduce
- *  processing time.
+ *  Implements the functions to control stepper motors, each one
+ *  using three pins (Enable, Direction and Steps) bound to a
+ *  motor_t object, so a program can drive several motors.
+ *
+ *  The pin functions are inline: when they are called directly on a
+ *  constant known to the compiler (a `static const` motor_t initialized
+ *  with MOTOR_PINS()), each pin change compiles to a single sbi/cbi
+ *  instruction, as fast as pins hardcoded in the module. This does not
+ *  apply to the step pulses of motor_move() and motor_line(): the
+ *  interrupt reaches the motors through pointers set at run time, so
+ *  each pin change is a load, modify and store.
+ *
+ *  Moves of several steps are generated by the Timer1 compare
+ *  interrupt (see motor_move()), so Timer1 is used by this module.
+ *  One move runs at a time: of one motor, or a straight line of up to
+ *  MOTOR_AXES motors stepped together (see motor_line()).
+ *  With an acceleration set by motor_set_accel(), moves accelerate from
+ *  standstill up to their rate and decelerate to stop on the last step
+ *  (see motor_ramp.h). motor_set_scurve() limits the jerk as well.
  */
 
 #ifndef _MOTOR_H_
 #define _MOTOR_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <util/delay.h>
+#include "motor_dda.h"
+#include "motor_ramp.h"
+
 
 #define MOTOR_STEPS_REV 200     /**< Define number of steps per revolution as configured by hardware */
 
+#define MOTOR_MIN_RATE  4       /**< Slowest rate of motor_move(), in steps/s */
+
 
 /**
  * @brief Defines de direction of the motor.
@@ -23,33 +47,193 @@ typedef enum {motor_wind=0, motor_unwind} motor_dir_t;
 
 
 /**
- * @brief Setup motor module.
- * 
- * Must be called before the rest of functions.
+ * @brief A motor: the port and the pin mask of each driver signal.
+ */
+typedef struct {
+  volatile uint8_t *ena_port;   /**< Enable (active low) */
+  uint8_t ena;
+  volatile uint8_t *stp_port;   /**< Step (a pulse per step) */
+  uint8_t stp;
+  volatile uint8_t *dir_port;   /**< Direction */
+  uint8_t dir;
+} motor_t;
+
+/**
+ * @brief Initializer of a motor_t with constant pins, e.g.
+ * `static const motor_t x = MOTOR_PINS(PORTB, 4, PORTB, 3, PORTB, 2);`
  */
-void motor_setup(void);
+#define MOTOR_PINS(ena_port, ena_pin, stp_port, stp_pin, dir_port, dir_pin) \
+  { &(ena_port), 1 << (ena_pin), &(stp_port), 1 << (stp_pin), &(dir_port), 1 << (dir_pin) }
+
+
+/**
+ * @brief Creates a motor object and sets up its pins.
+ *
+ * @param ena_port The AVR port (&PORTB, &PORTC...) of the Enable pin
+ * @param ena_pin The bit number of the Enable pin
+ * @param stp_port The AVR port of the Step pin
+ * @param stp_pin The bit number of the Step pin
+ * @param dir_port The AVR port of the Direction pin
+ * @param dir_pin The bit number of the Direction pin
+ * @return The motor object
+ */
+motor_t motor_create(volatile uint8_t *ena_port, uint8_t ena_pin,
+                     volatile uint8_t *stp_port, uint8_t stp_pin,
+                     volatile uint8_t *dir_port, uint8_t dir_pin);
+
+
+/**
+ * @brief Sets up the pins of a motor object initialized with MOTOR_PINS().
+ *
+ * Post: pins are outputs; step pin low; direction wind
+ *
+ * @param m The motor
+ */
+void motor_setup(const motor_t *m);
 
 
 /**
  * @brief Order one step.
  * 
  * Motor needs to be previously enabled by motor_enable()
+ *
+ * @param m The motor
+ */
+static inline void motor_step(const motor_t *m) {
+  *m->stp_port |= m->stp;
+  _delay_us(2);
+  *m->stp_port &= ~m->stp;
+}
+
+
+/**
+ * @brief Starts a move of a number of steps at a constant rate, in the
+ * current direction, and returns at once.
+ *
+ * The steps are generated by the Timer1 compare interrupt, so their
+ * timing does not depend on the main loop. Interrupts must be enabled
+ * and the motor enabled by motor_enable(). A move in progress, of this
+ * or another motor, is replaced. The direction must not change during a
+ * move.
+ *
+ * With an acceleration set, the move starts at the rate reached after one
+ * step of acceleration and speeds up to `steps_per_sec`, or stops
+ * accelerating halfway if the move is too short. Rates below 31 steps/s
+ * are never ramped.
+ *
+ * @param m The motor, which must stay valid until the move ends
+ * @param steps Number of steps (0 stops the motor)
+ * @param steps_per_sec Step rate, from MOTOR_MIN_RATE to the rate the
+ *        driver and the interrupt can sustain (tens of kHz; ramped moves
+ *        are limited to 31250 steps/s)
+ */
+void motor_move(const motor_t *m, uint16_t steps, uint16_t steps_per_sec);
+
+
+/**
+ * @brief Starts a straight line move of several motors, which all reach
+ * their target at the same time, and returns at once.
+ *
+ * The motor with the most steps (the dominant axis) moves as with
+ * motor_move(), including its acceleration, and the others step in
+ * proportion (see motor_dda.h), all from the same interrupt. Directions
+ * are set from the signs of `delta`.
+ *
+ * @param m The motors, which must stay valid until the move ends
+ * @param delta Steps of each motor: positive to wind, negative to unwind
+ * @param axes Number of motors: only the first MOTOR_AXES move if
+ *        there are more
+ * @param steps_per_sec Step rate of the dominant axis (see motor_move())
+ */
+void motor_line(const motor_t *const m[], const int16_t delta[], uint8_t axes,
+                uint16_t steps_per_sec);
+
+
+/**
+ * @brief Sets the acceleration and deceleration of the following moves,
+ * from a constant computed by motor_ramp_accel().
+ *
+ * @param a The acceleration (copied), or NULL for moves at a constant
+ *        rate (the default)
+ */
+void motor_use_accel(const motor_accel_t *a);
+
+
+/**
+ * @brief Sets the acceleration and deceleration of the following moves.
+ *
+ * Computing the acceleration constant takes a while: call it when the
+ * acceleration changes, not before every move. Inline, so programs that
+ * never set an acceleration do not link the computation.
+ *
+ * @param steps_per_sec2 Acceleration in steps/s^2, or 0 for moves at a
+ *        constant rate (the default)
+ */
+static inline void motor_set_accel(uint16_t steps_per_sec2) {
+  if (steps_per_sec2) {
+    motor_accel_t a;
+    motor_ramp_accel(&a, steps_per_sec2);
+    motor_use_accel(&a);
+  } else {
+    motor_use_accel(NULL);
+  }
+}
+
+
+/**
+ * @brief Makes the following moves follow an S-curve profile (limited
+ * jerk), replacing the acceleration of motor_set_accel().
+ *
+ * Moves reach at most the speed of the profile. The interrupt only reads
+ * the table of the profile, so it costs the same as a constant rate.
+ *
+ * @param s Profile from motor_scurve_build(), which must stay valid
+ *        while in use, or NULL for moves at a constant rate
+ */
+void motor_set_scurve(const motor_scurve_t *s);
+
+
+/**
+ * @brief Checks whether a move started by motor_move() is in progress.
+ */
+bool motor_is_busy(void);
+
+
+/**
+ * @brief Steps left of the move in progress (0 when idle): of the
+ * dominant axis for a line.
+ */
+uint16_t motor_remaining(void);
+
+
+/**
+ * @brief Stops the move in progress at once, without decelerating.
  */
-void motor_step(void);
+void motor_stop(void);
 
 
 /**
  * @brief Set a given turning direction.
  * 
+ * @param m The motor
  * @param d The desired direction
  */
-void motor_set_dir(motor_dir_t d);
+static inline void motor_set_dir(const motor_t *m, motor_dir_t d) {
+  if (d == 0)               // provision for configuring dir
+    *m->dir_port &= ~m->dir;
+  else
+    *m->dir_port |= m->dir;
+}
 
 
 /**
  * @brief Reverse the current direction.
+ *
+ * @param m The motor
  */
-void motor_reverse(void);
+static inline void motor_reverse(const motor_t *m) {
+  *(m->dir_port - 2) = m->dir;   // writing 1 to PINy toggles the PORTy bit
+}
 
 
 /**
@@ -57,8 +241,12 @@ void motor_reverse(void);
  * 
  * Motor is power feeded only while enabled, thus braking torque 
  * only effective while enabled.
+ *
+ * @param m The motor
  */
-void motor_enable(void);
+static inline void motor_enable(const motor_t *m) {
+  *m->ena_port &= ~m->ena;
+}
 
 
 /**
@@ -66,7 +254,11 @@ void motor_enable(void);
  * 
  * When the motor is disabled, no steps are executed but
  * avoids power consumption by removing the braking torque.
+ *
+ * @param m The motor
  */
-void motor_disable(void);
+static inline void motor_disable(const motor_t *m) {
+  *m->ena_port |= m->ena;
+}
 
 #endif
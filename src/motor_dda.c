@@ -0,0 +1,19 @@
+#include "motor_dda.h"
+
+
+uint16_t motor_dda_start(motor_dda_t *d, const uint16_t delta[], uint8_t axes) {
+  if (axes > MOTOR_AXES)
+    axes = MOTOR_AXES;
+  d->ticks = 0;
+  d->axes = axes;
+  for (uint8_t i = 0; i < axes; i++) {
+    d->delta[i] = delta[i];
+    if (delta[i] > d->ticks)
+      d->ticks = delta[i];
+  }
+  //Starting half way rounds every axis to the nearest step of the line
+  for (uint8_t i = 0; i < axes; i++) {
+    d->err[i] = d->ticks / 2;
+  }
+  return d->ticks;
+}
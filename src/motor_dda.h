@@ -0,0 +1,69 @@
+/** @file motor_dda.h
+ *  @brief Bresenham (DDA) distribution of the steps of a straight line
+ *  over several motor axes.
+ *
+ *  The axis with the most steps (the dominant axis) steps on every tick.
+ *  Each other axis accumulates its share of the ticks and steps whenever
+ *  it has a whole step, so at every tick each axis is within half a step
+ *  of the ideal line and all of them reach their target on the last tick.
+ *  A tick costs an addition and a comparison per axis: no division.
+ *
+ *  The module has no hardware dependency: the motor module calls it from
+ *  its timer interrupt, and host programs can check its output.
+ */
+
+#ifndef MOTOR_DDA_H
+#define MOTOR_DDA_H
+
+#include <stdint.h>
+
+/** Maximum number of axes of a line */
+#ifndef MOTOR_AXES
+#define MOTOR_AXES 3
+#endif
+
+/**
+ * @brief State of a line.
+ */
+typedef struct {
+  uint16_t ticks;              /**< Steps of the dominant axis */
+  uint16_t delta[MOTOR_AXES];  /**< Steps of each axis */
+  uint16_t err[MOTOR_AXES];    /**< Ticks accumulated towards the next step */
+  uint8_t axes;
+} motor_dda_t;
+
+
+/**
+ * @brief Plans a line.
+ *
+ * @param d The line
+ * @param delta Steps of each axis
+ * @param axes Number of axes (only the first MOTOR_AXES are used)
+ * @return The number of ticks of the line: steps of the dominant axis
+ */
+uint16_t motor_dda_start(motor_dda_t *d, const uint16_t delta[], uint8_t axes);
+
+
+/**
+ * @brief Advances the line by one tick.
+ *
+ * @param d The line
+ * @return The axes that step on this tick (bit i for axis i)
+ */
+static inline uint8_t motor_dda_next(motor_dda_t *d) {
+  uint8_t mask = 0;
+
+  for (uint8_t i = 0; i < d->axes; i++) {
+    //err + delta >= ticks, written so that it can not overflow
+    const uint16_t room = d->ticks - d->delta[i];
+    if (d->err[i] >= room) {
+      d->err[i] -= room;
+      mask |= 1 << i;
+    } else {
+      d->err[i] += d->delta[i];
+    }
+  }
+  return mask;
+}
+
+#endif
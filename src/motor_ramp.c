@@ -0,0 +1,197 @@
+#include "motor_ramp.h"
+
+
+/* Phases of a move */
+enum {
+  RAMP_ACCEL,
+  RAMP_CRUISE,
+  RAMP_DECEL
+};
+
+
+/*
+ * Integer square root, rounded down.
+ */
+static uint32_t isqrt32(uint32_t x) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+
+/*
+ * (x * y) >> 16 with two 16x16 bit multiplications.
+ */
+static uint32_t mul_hi16(uint32_t x, uint16_t y) {
+  return (uint32_t)(uint16_t)(x >> 16) * y + (((uint32_t)(uint16_t)x * y) >> 16);
+}
+
+
+/*
+ * A step at constant acceleration changes the speed by v'^2 = v^2 +/- 2a,
+ * so with q = m * p^2 the next interval is p / sqrt(1 +/- 2q). This is
+ * computed as p -/+ p * q * c(q), where c(q) is interpolated from these
+ * tables (4.12 fixed point, q from 0 to 1/2 in steps of 1/32). At high
+ * speed q is tiny and c(q) is 1, the first order recurrence.
+ */
+#define RAMP_Q_STEP_BITS 11     // q of 0.16 fixed point: 1/32 per entry
+
+static const uint16_t ramp_accel_c[17] = {
+  4096, 3913, 3748, 3597, 3459, 3333, 3216, 3107, 3007,
+  2913, 2825, 2743, 2666, 2593, 2525, 2460, 2399
+};
+
+static const uint16_t ramp_decel_c[17] = {
+  4096, 4299, 4525, 4780, 5069, 5401, 5787, 6242, 6786,
+  7454, 8297, 9400, 10923, 13202, 17118, 26214, 26214
+};
+
+
+/*
+ * (pq * c) >> 12, keeping the fraction bits while pq is small, and
+ * saturated to `limit`.
+ */
+static uint32_t ramp_delta(uint32_t pq, uint16_t c, uint32_t limit) {
+  if (pq <= 0xFFFF) {
+    const uint32_t delta = ((uint32_t)(uint16_t)pq * c) >> 12;
+    return (delta < limit) ? delta : limit;
+  }
+  const uint32_t hi = mul_hi16(pq, c);
+  return (hi < limit >> 4) ? hi << 4 : limit;
+}
+
+
+static uint16_t ramp_interpolate(const uint16_t c[17], uint16_t q) {
+  const uint8_t i = q >> RAMP_Q_STEP_BITS;
+  const uint16_t frac = q & ((1 << RAMP_Q_STEP_BITS) - 1);
+
+  if (i >= 16)
+    return c[16];
+  /* The difference wraps around in 16 bits, as int does on AVR (also on
+   * the host through the cast): signed, it is right for decreasing tables */
+  const int16_t slope = (int16_t)(uint16_t)(c[i + 1] - c[i]);
+  return c[i] + (int16_t)(((int32_t)slope * frac) >> RAMP_Q_STEP_BITS);
+}
+
+
+uint16_t motor_ramp_start(motor_ramp_t *r, const motor_accel_t *a, uint16_t steps, uint16_t max_rate) {
+  /* The recurrence starts at the interval where m * p^2 = 1/2, i.e. a
+   * speed of sqrt(2 * accel) steps/s: F / sqrt(2 * accel) ticks */
+  uint32_t p = (uint32_t)MOTOR_RAMP_HZ * 16 / isqrt32((uint32_t)a->rate << 9);
+  uint32_t min_p = MOTOR_RAMP_HZ / (max_rate ? max_rate : 1);
+
+  if (p > MOTOR_RAMP_MAX_TICKS)
+    p = MOTOR_RAMP_MAX_TICKS;
+  if (min_p < MOTOR_RAMP_MIN_TICKS)
+    min_p = MOTOR_RAMP_MIN_TICKS;
+  if (min_p >= p) {
+    //Maximum speed below the start speed: no ramps
+    p = (min_p > MOTOR_RAMP_MAX_TICKS) ? MOTOR_RAMP_MAX_TICKS : min_p;
+    min_p = p;
+  }
+
+  r->accel = *a;
+  r->min_period = min_p << 16;
+  r->max_period = p << 16;
+  r->period = p << 16;
+  r->left = steps;
+  r->ramp = 0;
+  r->phase = (min_p == p) ? RAMP_CRUISE : RAMP_ACCEL;
+  return p;
+}
+
+
+uint16_t motor_ramp_next(motor_ramp_t *r) {
+  if (r->left <= 1) {
+    r->left = 0;
+    return 0;
+  }
+  r->left--;
+
+  //q = m * p^2 (0.32 fixed point) and p * q (16.16)
+  const uint16_t p = r->period >> 16;
+  const uint32_t t = mul_hi16((uint32_t)p * p, r->accel.mantissa);
+  const uint32_t q = (r->accel.exp >= 16) ?
+    t >> (r->accel.exp - 16) : t << (16 - r->accel.exp);
+  const uint32_t pq = mul_hi16(q, p);
+  uint32_t limit;
+
+  switch (r->phase) {
+  case RAMP_ACCEL:
+    r->ramp++;
+    limit = r->period - r->min_period;
+    r->period -= ramp_delta(pq, ramp_interpolate(ramp_accel_c, q >> 16), limit);
+    if (r->period == r->min_period) {
+      r->phase = RAMP_CRUISE;
+    }
+    if (r->left <= r->ramp) {
+      r->phase = RAMP_DECEL;    // too short to reach the maximum speed
+    }
+    break;
+  case RAMP_CRUISE:
+    if (r->left <= r->ramp) {
+      r->phase = RAMP_DECEL;
+    }
+    break;
+  default:
+    //Rounding may bring the speed down a few steps early: the last ones
+    //are then made at the start speed
+    limit = r->max_period - r->period;
+    r->period += ramp_delta(pq, ramp_interpolate(ramp_decel_c, q >> 16), limit);
+    break;
+  }
+  return r->period >> 16;
+}
+
+
+uint16_t motor_scurve_start(motor_scurve_move_t *m, const motor_scurve_t *s,
+                            uint16_t steps, uint16_t max_rate) {
+  m->s = s;
+  m->step = 0;
+  m->steps = steps;
+  m->ramp = s->steps;
+  m->cruise = MOTOR_RAMP_HZ / (s->rate ? s->rate : 1);
+
+  if (max_rate < s->rate) {
+    //Stop accelerating at the first entry reaching max_rate
+    const uint32_t cruise = MOTOR_RAMP_HZ / (max_rate ? max_rate : 1);
+    uint16_t lo = 0, hi = s->steps;
+    m->cruise = (cruise > MOTOR_RAMP_MAX_TICKS) ? MOTOR_RAMP_MAX_TICKS : cruise;
+    while (lo < hi) {
+      const uint16_t mid = (lo + hi) / 2;
+      if (s->interval[mid] <= m->cruise)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    m->ramp = lo;
+  }
+  return motor_scurve_next(m);
+}
+
+
+uint16_t motor_scurve_next(motor_scurve_move_t *m) {
+  if (m->step == m->steps) {
+    return 0;
+  }
+  /* Before step k the interval is entry k - 1 accelerating, and the same
+   * one mirrored (steps - k) decelerating */
+  const uint16_t up = m->step;
+  const uint16_t down = m->steps - ++m->step;
+  const uint16_t i = (up < down) ? up : down;
+
+  return (i < m->ramp) ? m->s->interval[i] : m->cruise;
+}
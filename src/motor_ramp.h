@@ -0,0 +1,167 @@
+/** @file motor_ramp.h
+ *  @brief Step interval generator of trapezoidal speed profiles.
+ *
+ *  Computes the interval of every step of a move that accelerates at a
+ *  constant rate up to a maximum speed, cruises and decelerates to stop
+ *  on the last step (a triangle if the move is too short to reach the
+ *  maximum speed). This is the incremental delay computation of Atmel
+ *  AVR446, where the division of each step is replaced by the exact
+ *  recurrence `p' = p / sqrt(1 +/- 2 * m * p^2)`, with `m = accel / F^2`,
+ *  evaluated from a small interpolated table: a step only costs a few
+ *  16x16 bit multiplications, no division and no float.
+ *
+ *  S-curve (jerk-limited) profiles ramp the acceleration up and down as
+ *  well, so the speed has no corners that excite resonances. Their
+ *  acceleration is computed once into a table of step intervals
+ *  (motor_scurve_build()) and every move plays it forward to accelerate
+ *  and backward to decelerate: a step only costs a table read.
+ *
+ *  The module has no hardware dependency: the motor module calls it from
+ *  its timer interrupt, and host programs can check its output. The
+ *  builders of the profiles, motor_ramp_accel() and motor_scurve_build(),
+ *  are in their own object (motor_ramp_build), so the 64 bit and float
+ *  code is only linked by programs that compute a profile.
+ */
+
+#ifndef MOTOR_RAMP_H
+#define MOTOR_RAMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOTOR_RAMP_HZ   (F_CPU / 8)   /**< Tick rate of the intervals (Timer1, prescaler 8) */
+
+/** Slowest interval (and start speed: 31 steps/s at 16MHz) */
+#define MOTOR_RAMP_MAX_TICKS 0xFFFF
+
+/** Fastest interval the step interrupt is given time for */
+#define MOTOR_RAMP_MIN_TICKS 64
+
+/**
+ * @brief Acceleration constant `m = accel / F^2`, as a 16 bit mantissa
+ * and a binary exponent.
+ */
+typedef struct {
+  uint16_t rate;         /**< Acceleration in steps/s^2 */
+  uint16_t mantissa;     /**< `m = mantissa * 2^-(32 + exp)` */
+  uint8_t exp;
+} motor_accel_t;
+
+/**
+ * @brief State of a move.
+ */
+typedef struct {
+  motor_accel_t accel;
+  uint32_t period;       /**< Current interval, in ticks (16.16 fixed point) */
+  uint32_t min_period;   /**< Interval at the maximum speed (16.16) */
+  uint32_t max_period;   /**< Interval at the start speed (16.16) */
+  uint16_t left;         /**< Steps left */
+  uint16_t ramp;         /**< Steps spent accelerating */
+  uint8_t phase;
+} motor_ramp_t;
+
+
+/**
+ * @brief Computes the acceleration constant. Slow (64 bit divisions):
+ * call it when the acceleration changes, not for every move.
+ *
+ * @param a The result
+ * @param steps_per_sec2 Acceleration (1 or more)
+ */
+void motor_ramp_accel(motor_accel_t *a, uint16_t steps_per_sec2);
+
+
+/**
+ * @brief Plans a move from standstill.
+ *
+ * @param r The move
+ * @param a Acceleration constant from motor_ramp_accel()
+ * @param steps Number of steps (1 or more)
+ * @param max_rate Maximum speed in steps/s
+ * @return The interval before the first step, in ticks
+ */
+uint16_t motor_ramp_start(motor_ramp_t *r, const motor_accel_t *a, uint16_t steps, uint16_t max_rate);
+
+
+/**
+ * @brief Accounts for a step just made and computes the interval until
+ * the next one.
+ *
+ * @param r The move
+ * @return The interval in ticks, or 0 if that was the last step
+ */
+uint16_t motor_ramp_next(motor_ramp_t *r);
+
+
+/**
+ * @brief Acceleration of an S-curve profile, from standstill to its
+ * maximum speed.
+ */
+typedef struct {
+  uint16_t *interval;    /**< Interval before each step, in ticks */
+  uint16_t size;         /**< Capacity of `interval` */
+  uint16_t steps;        /**< Steps of the acceleration (used entries) */
+  uint16_t rate;         /**< Speed reached, in steps/s */
+} motor_scurve_t;
+
+/**
+ * @brief State of a move with an S-curve profile.
+ */
+typedef struct {
+  const motor_scurve_t *s;
+  uint16_t step;         /**< Steps made */
+  uint16_t steps;        /**< Steps of the move */
+  uint16_t ramp;         /**< Entries of the table used by the move */
+  uint16_t cruise;       /**< Interval at the maximum speed */
+} motor_scurve_move_t;
+
+
+/**
+ * @brief Computes the acceleration table of an S-curve profile: the
+ * acceleration grows at `jerk` up to `accel`, stays there and decreases
+ * at `jerk` to reach `max_rate` with no acceleration.
+ *
+ * Slow (float): call it when the profile changes, not for every move.
+ * If the acceleration does not fit in `size` steps, the profile is
+ * computed for the highest speed that fits.
+ *
+ * @param s The profile
+ * @param interval Storage of the table
+ * @param size Entries of `interval`
+ * @param max_rate Maximum speed in steps/s
+ * @param accel Maximum acceleration in steps/s^2 (1 or more)
+ * @param jerk Rate of change of the acceleration in steps/s^3 (1 or more)
+ * @return The maximum speed of the profile, in steps/s
+ */
+uint16_t motor_scurve_build(motor_scurve_t *s, uint16_t *interval, uint16_t size,
+                            uint16_t max_rate, uint16_t accel, uint32_t jerk);
+
+
+/**
+ * @brief Plans a move from standstill with an S-curve profile.
+ *
+ * Moves too short to reach the speed of the profile decelerate as soon
+ * as they are halfway. A `max_rate` below the speed of the profile cuts
+ * the acceleration short: build the profile for that speed to keep it
+ * smooth.
+ *
+ * @param m The move
+ * @param s Profile from motor_scurve_build()
+ * @param steps Number of steps (1 or more)
+ * @param max_rate Maximum speed in steps/s
+ * @return The interval before the first step, in ticks
+ */
+uint16_t motor_scurve_start(motor_scurve_move_t *m, const motor_scurve_t *s,
+                            uint16_t steps, uint16_t max_rate);
+
+
+/**
+ * @brief Accounts for a step just made and gets the interval until the
+ * next one. Constant time.
+ *
+ * @param m The move
+ * @return The interval in ticks, or 0 if that was the last step
+ */
+uint16_t motor_scurve_next(motor_scurve_move_t *m);
+
+#endif
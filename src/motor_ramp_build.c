@@ -0,0 +1,138 @@
+#include <math.h>
+#include "motor_ramp.h"
+
+/*
+ * Builders of the motor_ramp profiles: 64 bit divisions and float, kept
+ * apart from the step interval generators so that programs that do not
+ * set an acceleration do not link them.
+ */
+
+
+void motor_ramp_accel(motor_accel_t *a, uint16_t steps_per_sec2) {
+  const uint64_t f2 = (uint64_t)MOTOR_RAMP_HZ * MOTOR_RAMP_HZ;
+  const uint64_t num = (uint64_t)(steps_per_sec2 ? steps_per_sec2 : 1) << 40;
+  uint64_t m;
+  uint8_t shift = 0;
+
+  //Normalize the mantissa to [2^15, 2^16): m = accel * 2^(40 + shift) / F^2
+  while ((m = num / (f2 >> shift)) < 0x8000) {
+    shift++;
+  }
+  a->rate = steps_per_sec2 ? steps_per_sec2 : 1;
+  a->mantissa = m;
+  a->exp = 40 + shift - 32;
+}
+
+
+/*
+ * S-curve acceleration from standstill to speed v: jerk phase (the
+ * acceleration grows to ap), constant acceleration, jerk phase (the
+ * acceleration drops to 0). Times in seconds, distances in steps.
+ */
+typedef struct {
+  float j;               // jerk
+  float ap;              // peak acceleration
+  float tj;              // duration of each jerk phase
+  float ta;              // duration of the constant acceleration
+} scurve_shape_t;
+
+
+static void scurve_shape(scurve_shape_t *c, float v, float accel, float jerk) {
+  c->j = jerk;
+  c->tj = accel / jerk;
+  if (v >= accel * c->tj) {
+    c->ta = v / accel - c->tj;
+  } else {
+    //The speed is reached before the acceleration
+    c->tj = sqrtf(v / jerk);
+    c->ta = 0;
+  }
+  c->ap = jerk * c->tj;
+}
+
+
+/* Distance of the whole acceleration (its average speed is v / 2) */
+static float scurve_length(const scurve_shape_t *c) {
+  const float v = c->ap * (c->tj + c->ta);
+
+  return v / 2 * (2 * c->tj + c->ta);
+}
+
+
+/* Distance and speed at time t */
+static float scurve_position(const scurve_shape_t *c, float t, float *v) {
+  const float v1 = c->j * c->tj * c->tj / 2;
+  const float s1 = v1 * c->tj / 3;
+
+  if (t <= c->tj) {
+    *v = c->j * t * t / 2;
+    return *v * t / 3;
+  }
+  t -= c->tj;
+  if (t <= c->ta) {
+    *v = v1 + c->ap * t;
+    return s1 + (v1 + *v) / 2 * t;
+  }
+  const float v2 = v1 + c->ap * c->ta;
+  const float s2 = s1 + (v1 + v2) / 2 * c->ta;
+
+  t -= c->ta;
+  if (t > c->tj) {
+    t = c->tj;
+  }
+  *v = v2 + c->ap * t - c->j * t * t / 2;
+  return s2 + v2 * t + c->ap * t * t / 2 - c->j * t * t * t / 6;
+}
+
+
+uint16_t motor_scurve_build(motor_scurve_t *s, uint16_t *interval, uint16_t size,
+                            uint16_t max_rate, uint16_t accel, uint32_t jerk) {
+  const float a = accel ? accel : 1;
+  const float j = jerk ? jerk : 1;
+  float v = (max_rate < MOTOR_RAMP_HZ / MOTOR_RAMP_MIN_TICKS) ?
+    max_rate : MOTOR_RAMP_HZ / MOTOR_RAMP_MIN_TICKS;
+  scurve_shape_t c;
+
+  scurve_shape(&c, v, a, j);
+  if (scurve_length(&c) > size) {
+    //Highest speed whose acceleration fits in the table
+    float lo = 0, hi = v;
+    for (uint8_t i = 0; i < 24; i++) {
+      v = (lo + hi) / 2;
+      scurve_shape(&c, v, a, j);
+      if (scurve_length(&c) > size)
+        hi = v;
+      else
+        lo = v;
+    }
+    v = lo;
+    scurve_shape(&c, v, a, j);
+  }
+
+  /* Time of each step: s(t) = n, by Newton iterations from the previous
+   * step. Intervals are differences of rounded times, so the error of
+   * a step time never builds up. */
+  const uint16_t n = scurve_length(&c);
+  float t = cbrtf(6 / j);          // first step, exact
+  uint32_t before = 0;
+
+  for (uint16_t i = 0; i < n; i++) {
+    float vt;
+    for (uint8_t k = 0; k < 4; k++) {
+      const float d = (i + 1) - scurve_position(&c, t, &vt);
+      if (vt > 0)
+        t += d / vt;
+    }
+    const uint32_t now = lroundf(t * MOTOR_RAMP_HZ);
+    const uint32_t ticks = now - before;
+    interval[i] = (ticks > MOTOR_RAMP_MAX_TICKS) ? MOTOR_RAMP_MAX_TICKS : ticks;
+    before = now;
+    t += 1 / vt;                   // guess of the next step
+  }
+
+  s->interval = interval;
+  s->size = size;
+  s->steps = n;
+  s->rate = v;
+  return s->rate;
+}
@@ -0,0 +1,207 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdio.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+#include "serial.h"
+#include "i2c.h"
+#include "lcd_i2c.h"
+#include "hd44780_par.h"
+
+/**
+ * @brief Throughput benchmark of the display path of both drivers:
+ * `lcd_i2c` (PCF8574 backpack at 100kHz, busy flag pacing) and
+ * `hd44780_par` (4-bit bus, fixed delays).
+ *
+ * Each standard workload is timed with Timer1 until the last byte has
+ * left the AVR (for I2C, until the last transaction has completed) and
+ * reported over the serial port as time and characters or commands per
+ * second. Run it before and after a change to the display path to
+ * measure its effect. The I2C bytes and transactions of the same
+ * workloads are counted by the host emulator (`make -C test/host run`,
+ * "workloads" section).
+ *
+ * Workloads:
+ *  - full redraw: clear and print the 4 rows (80 characters)
+ *  - field update: move the cursor and print a 5 character field
+ *  - glyph upload: one custom character (command plus 8 bytes)
+ *  - cursor moves: 20 moves to different cells
+ */
+
+
+//I2C display
+#define LCD_I2C_ADDRESS 0x3F
+#define LCD_ROWS        4
+#define LCD_COLS        20
+
+//Parallel display: D4-D7 on PC0-PC3, RS on PC4, EN on PC5, RW to ground
+#define LCD_RS 4
+#define LCD_EN 5
+
+
+// setup stdout
+static int write(char s, FILE *stream) {
+  if (s == '\n'){
+    serial_write('\r');
+    serial_write('\n');
+  } else serial_write(s);
+  return 0;
+}
+
+static FILE mystdout = FDEV_SETUP_STREAM(write, NULL,
+                                         _FDEV_SETUP_WRITE);
+
+
+/* Timer1 at clk/64: 4us per tick at 16MHz, up to 262ms */
+#define TICK_PRESCALER 64
+
+static void ticks_start(void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TCNT1 = 0;
+  }
+}
+
+static uint32_t ticks_us(void) {
+  uint16_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    t = TCNT1;
+  }
+  return (uint32_t)t * TICK_PRESCALER / (F_CPU / 1000000UL);
+}
+
+
+/*
+ * Prints a result line: time and operations per second.
+ * @param name The workload
+ * @param us Time spent
+ * @param ops Characters or commands of the workload
+ */
+static void report(const char *name, uint32_t us, uint16_t ops) {
+  const uint32_t rate = us ? (uint32_t)ops * 1000000UL / us : 0;
+
+  printf("%-16s %7lu us %6lu op/s\n", name, us, rate);
+}
+
+
+static const uint8_t bell[8] = {0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00};
+
+static char rows[LCD_ROWS][LCD_COLS + 1] = {
+  "Row 0: benchmarking ",
+  "Row 1: the display  ",
+  "Row 2: path of both ",
+  "Row 3: LCD drivers  "
+};
+
+
+/* Waits until the last I2C transaction of the display has completed */
+static void i2c_lcd_idle(lcd_t *l) {
+  while (l->i2c_comm == Running);
+}
+
+
+static void bench_i2c(lcd_t *l) {
+  uint32_t us;
+
+  puts("== lcd_i2c (100kHz, busy flag)");
+
+  ticks_start();
+  lcd_clear(l, true);
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    lcd_move_cursor(l, 0, r);
+    lcd_print(l, rows[r]);
+  }
+  i2c_lcd_idle(l);
+  us = ticks_us();
+  report("full redraw", us, LCD_ROWS * LCD_COLS);
+
+  ticks_start();
+  lcd_move_cursor(l, 15, 1);
+  lcd_print(l, "12345");
+  i2c_lcd_idle(l);
+  us = ticks_us();
+  report("field update", us, 5);
+
+  ticks_start();
+  lcd_create_char(l, 0, (uint8_t *)bell);
+  i2c_lcd_idle(l);
+  us = ticks_us();
+  report("glyph upload", us, 1);
+
+  ticks_start();
+  for (uint8_t c = 0; c < LCD_COLS; c++) {
+    lcd_move_cursor(l, c, c & 0x03);
+  }
+  i2c_lcd_idle(l);
+  us = ticks_us();
+  report("cursor moves", us, LCD_COLS);
+}
+
+
+static void bench_parallel(hd44780_par_t *p) {
+  uint32_t us;
+
+  puts("== hd44780_par (4-bit, fixed delays)");
+
+  ticks_start();
+  hd44780_send(&p->hd, LCD_COMMAND, LCD_CLEARDISPLAY);
+  hd44780_par_wait_slow(p);
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    hd44780_move_cursor(&p->hd, 0, r);
+    hd44780_print(&p->hd, rows[r]);
+  }
+  us = ticks_us();
+  report("full redraw", us, LCD_ROWS * LCD_COLS);
+
+  ticks_start();
+  hd44780_move_cursor(&p->hd, 15, 1);
+  hd44780_print(&p->hd, "12345");
+  us = ticks_us();
+  report("field update", us, 5);
+
+  ticks_start();
+  hd44780_create_char(&p->hd, 0, bell);
+  us = ticks_us();
+  report("glyph upload", us, 1);
+
+  ticks_start();
+  for (uint8_t c = 0; c < LCD_COLS; c++) {
+    hd44780_move_cursor(&p->hd, c, c & 0x03);
+  }
+  us = ticks_us();
+  report("cursor moves", us, LCD_COLS);
+}
+
+
+int main(){
+  lcd_t i2c_lcd = lcd_constructor(LCD_I2C_ADDRESS, LCD_ROWS);
+  hd44780_par_t par_lcd = hd44780_par_start(&PORTC, LCD_RS, LCD_NO_RW, LCD_EN, NULL);
+
+  serial_setup();
+  i2c_setup();
+  sei();
+
+  stdout = &mystdout;
+  serial_open();
+  i2c_open();
+
+  _delay_ms(50);
+  lcd_init(&i2c_lcd);
+  lcd_set_pacing(&i2c_lcd, LCD_PACE_BUSY_FLAG);
+  for (uint16_t t = HD44780_PAR_POWER_ON_MS; !hd44780_par_step(&par_lcd, t); t++) {
+    _delay_ms(1);
+  }
+
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10);   //clk/64
+
+  bench_i2c(&i2c_lcd);
+  bench_parallel(&par_lcd);
+  puts("== end");
+
+  for(;;);
+
+  i2c_close();
+  serial_close();
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdio.h>
+#include "serial.h"
+#include "lcd.h"
+
+/*
+ * Benchmark of the call overhead of the parallel `lcd` driver: the
+ * `lcd_t *` handles against the same calls made through a by-value
+ * wrapper, which copies the whole object once per call. The former
+ * by-value convention also copied it again on each nested call down to
+ * the nibble writes, so the "1 copy" column is a lower bound of its cost.
+ *
+ * The display is on PORTC: D4-D7 on PC0-PC3, RS on PC4 and EN on PC5.
+ * Results (CPU cycles) are reported over the serial port.
+ */
+
+#define LCD_RS 4
+#define LCD_EN 5
+
+
+// setup stdout
+static int write(char s, FILE *stream) {
+  if (s == '\n'){
+    serial_write('\r');
+    serial_write('\n');
+  } else serial_write(s);
+  return 0;
+}
+
+static FILE mystdout = FDEV_SETUP_STREAM(write, NULL,
+                                         _FDEV_SETUP_WRITE);
+
+
+/* One copy of the object per call, then the pointer path below it */
+static void __attribute__((noinline)) by_value_move_cursor(lcd_t l, uint8_t col, uint8_t row) {
+  lcd_move_cursor(&l, col, row);
+}
+
+static void __attribute__((noinline)) by_value_send(lcd_t l, bool rs_mode, uint8_t value) {
+  lcd_send(&l, rs_mode, value);
+}
+
+
+/* Timer1 counts CPU cycles (no prescaler) */
+#define CYCLES_START() do { cli(); TCNT1 = 0; } while (0)
+#define CYCLES_STOP(c) do { c = TCNT1; sei(); } while (0)
+
+
+int main(){
+  uint16_t c1, c2;
+
+  serial_setup();
+  sei();
+
+  stdout = &mystdout;
+  serial_open();
+
+  lcd_t lcd = lcd_bind(&PORTC, LCD_RS, LCD_EN);
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+
+  puts("== cycles per call");
+  puts("call                   lcd_t *     1 copy");
+
+  // The cursor is already there: nothing is sent, only the call is timed
+  lcd_move_cursor(&lcd, 0, 1);
+  CYCLES_START();
+  lcd_move_cursor(&lcd, 0, 1);
+  CYCLES_STOP(c1);
+  CYCLES_START();
+  by_value_move_cursor(lcd, 0, 1);
+  CYCLES_STOP(c2);
+  printf("%-20s %8u %10u\n", "move_cursor (no-op)", c1, c2);
+
+  CYCLES_START();
+  lcd_send(&lcd, LCD_DATA, 'A');
+  CYCLES_STOP(c1);
+  CYCLES_START();
+  by_value_send(lcd, LCD_DATA, 'B');
+  CYCLES_STOP(c2);
+  printf("%-20s %8u %10u\n", "send (2x50us)", c1, c2);
+
+  puts("== end");
+
+  for(;;);
+
+  serial_close();
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "serial.h"
+#include "i2c.h"
+#include "lcd_i2c.h"
+
+/**
+ * @brief Benchmark of `lcd_printf` against the `vsnprintf` path used by
+ * the parallel driver (format into a buffer, then `lcd_print`).
+ *
+ * A shadow framebuffer is attached, so no I2C traffic is involved and
+ * the figures are the CPU cycles spent formatting one field and storing
+ * it in the display path. Results are reported over the serial port.
+ */
+
+
+#define LCD_I2C_ADDRESS 0x3F
+#define LCD_ROWS        4
+#define LCD_COLS        20
+
+static lcd_shadow_t shadow;
+
+
+// setup stdout
+static int write(char s, FILE *stream) {
+  if (s == '\n'){
+    serial_write('\r');
+    serial_write('\n');
+  } else serial_write(s);
+  return 0;
+}
+
+static FILE mystdout = FDEV_SETUP_STREAM(write, NULL,
+                                         _FDEV_SETUP_WRITE);
+
+
+/* The `vsnprintf` path, as in lcd.c */
+static void vsnprintf_print(lcd_t *l, char *format, ...) {
+  va_list args;
+  char buffer[LCD_COLS + 1];
+
+  va_start(args, format);
+  vsnprintf(buffer, LCD_COLS + 1, format, args);
+  va_end(args);
+
+  lcd_print(l, buffer);
+}
+
+
+/* Timer1 counts CPU cycles (no prescaler) */
+#define CYCLES_START() do { cli(); TCNT1 = 0; } while (0)
+#define CYCLES_STOP(c) do { c = TCNT1; sei(); } while (0)
+
+#define BENCH(name, ...) do {                          \
+    uint16_t c1, c2;                                   \
+    lcd_move_cursor(&lcd, 0, 0);                       \
+    CYCLES_START();                                    \
+    lcd_printf(&lcd, __VA_ARGS__);                     \
+    CYCLES_STOP(c1);                                   \
+    lcd_move_cursor(&lcd, 0, 0);                       \
+    CYCLES_START();                                    \
+    vsnprintf_print(&lcd, __VA_ARGS__);                \
+    CYCLES_STOP(c2);                                   \
+    printf("%-12s %8u %10u\n", name, c1, c2);          \
+  } while (0)
+
+
+int main(){
+  lcd_t lcd = lcd_constructor(LCD_I2C_ADDRESS, LCD_ROWS);
+
+  serial_setup();
+  i2c_setup();
+  sei();
+
+  stdout = &mystdout;
+  serial_open();
+  i2c_open();
+
+  //Only the shadow is written: the panel is not even initialized
+  lcd_attach_shadow(&lcd, &shadow, LCD_COLS);
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+
+  puts("== cycles per formatted field");
+  puts("field        lcd_printf  vsnprintf");
+  BENCH("%d",     "%d", -12345);
+  BENCH("%5u",    "%5u", 42);
+  BENCH("%04x",   "%04x", 0xBEEF);
+  BENCH("%ld",    "%ld", 1234567L);
+  BENCH("%s",     "%s", "status");
+  BENCH("%c",     "%c", '#');
+  //Fixed-point: `%.2f` of 12.34 against the usual integer split
+  {
+    uint16_t c1, c2;
+    lcd_move_cursor(&lcd, 0, 0);
+    CYCLES_START();
+    lcd_printf(&lcd, "%.2f", 1234);
+    CYCLES_STOP(c1);
+    lcd_move_cursor(&lcd, 0, 0);
+    CYCLES_START();
+    vsnprintf_print(&lcd, "%d.%02d", 1234 / 100, 1234 % 100);
+    CYCLES_STOP(c2);
+    printf("%-12s %8u %10u\n", "%.2f", c1, c2);
+  }
+  puts("== end");
+
+  for(;;);
+
+  i2c_close();
+  serial_close();
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <stddef.h>
+#include "i2c.h"
+#include "util/delay.h"
+#include "avr_emu.h"
+
+
+uint32_t emu_clock_us;
+uint8_t emu_i2c_bit_us = 10;
+emu_i2c_stats_t emu_i2c_stats;
+int16_t emu_i2c_room = -1;
+
+static struct {
+  uint8_t address;
+  hd44780_emu_t *lcd;
+} devices[AVR_EMU_DEVICES];
+
+
+void emu_reset(void) {
+  for (uint8_t i = 0; i < AVR_EMU_DEVICES; i++) {
+    devices[i].lcd = NULL;
+  }
+  emu_clock_us = 0;
+  emu_i2c_stats = (emu_i2c_stats_t){0, 0};
+  emu_i2c_room = -1;
+}
+
+
+void emu_attach_lcd(uint8_t address, hd44780_emu_t *lcd) {
+  for (uint8_t i = 0; i < AVR_EMU_DEVICES; i++) {
+    if (!devices[i].lcd) {
+      devices[i].address = address;
+      devices[i].lcd = lcd;
+      return;
+    }
+  }
+}
+
+
+void emu_idle_us(uint32_t us) {
+  emu_clock_us += us;
+}
+
+
+void _delay_ms(double ms) {
+  emu_clock_us += (uint32_t)(ms * 1000);
+}
+
+
+void _delay_us(double us) {
+  emu_clock_us += (uint32_t)us;
+}
+
+
+/* Start condition and address byte; NULL if nobody acknowledges */
+static hd44780_emu_t *start(uint8_t address) {
+  if (emu_i2c_room > 0) {
+    emu_i2c_room--;
+  }
+  emu_i2c_stats.transactions++;
+  emu_i2c_stats.bytes++;
+  emu_clock_us += emu_i2c_bit_us * 10;
+  for (uint8_t i = 0; i < AVR_EMU_DEVICES; i++) {
+    if (devices[i].lcd && devices[i].address == address) {
+      return devices[i].lcd;
+    }
+  }
+  return NULL;
+}
+
+
+static void stop(volatile i2c_status_t *st, hd44780_emu_t *lcd) {
+  emu_clock_us += emu_i2c_bit_us;
+  if (st) {
+    *st = lcd ? Success : Error;
+  }
+}
+
+
+static void transfer_out(hd44780_emu_t *lcd, const uint8_t buf[], uint8_t len) {
+  for (uint8_t i = 0; lcd && i < len; i++) {
+    emu_i2c_stats.bytes++;
+    emu_clock_us += emu_i2c_bit_us * 9;
+    hd44780_emu_write(lcd, buf[i]);
+  }
+}
+
+
+static void transfer_in(hd44780_emu_t *lcd, uint8_t buf[], uint8_t len) {
+  for (uint8_t i = 0; lcd && i < len; i++) {
+    emu_i2c_stats.bytes++;
+    emu_clock_us += emu_i2c_bit_us * 9;
+    buf[i] = hd44780_emu_read(lcd);
+  }
+}
+
+
+void i2c_setup(void) {
+}
+
+
+void i2c_open(void) {
+}
+
+
+void i2c_close(void) {
+}
+
+
+bool i2c_swamped(void) {
+  return emu_i2c_room == 0;
+}
+
+
+void i2c_send(uint8_t address, const uint8_t buf[], uint8_t len,
+              volatile i2c_status_t *st) {
+  hd44780_emu_t *lcd = start(address);
+  transfer_out(lcd, buf, len);
+  stop(st, lcd);
+}
+
+
+void i2c_send_uint8(uint8_t address, uint8_t value, volatile i2c_status_t *st) {
+  i2c_send(address, &value, 1, st);
+}
+
+
+void i2c_receive(uint8_t address, uint8_t buf[], uint8_t len,
+                 volatile i2c_status_t *st) {
+  hd44780_emu_t *lcd = start(address);
+  transfer_in(lcd, buf, len);
+  stop(st, lcd);
+}
+
+
+void i2c_receive_uint8(uint8_t address, uint8_t *value,
+                       volatile i2c_status_t *st) {
+  i2c_receive(address, value, 1, st);
+}
+
+
+void i2c_sandr(uint8_t address, const uint8_t sbuf[], uint8_t slen,
+               uint8_t rbuf[], uint8_t rlen, volatile i2c_status_t *st) {
+  hd44780_emu_t *lcd = start(address);
+  transfer_out(lcd, sbuf, slen);
+  emu_i2c_stats.bytes++;                 //Repeated start and address byte
+  emu_clock_us += emu_i2c_bit_us * 10;
+  transfer_in(lcd, rbuf, rlen);
+  stop(st, lcd);
+}
@@ -0,0 +1,54 @@
+/** @file avr_emu.h
+ *  @brief Simulated clock and I2C bus behind the host shims.
+ *
+ *  Time only advances when the code under test transfers bytes on the
+ *  bus (9 bit times per byte plus start and stop) or calls `_delay_*`.
+ *  Every transaction is complete when the i2c call returns.
+ */
+
+#ifndef AVR_EMU_H
+#define AVR_EMU_H
+
+#include <stdint.h>
+#include "hd44780_emu.h"
+
+#define AVR_EMU_DEVICES 4       /**< Devices that can be attached to the bus */
+
+/** Simulated time in us since power on */
+extern uint32_t emu_clock_us;
+
+/** I2C bit time in us (10 for the usual 100kHz bus) */
+extern uint8_t emu_i2c_bit_us;
+
+/** Bus counters */
+typedef struct {
+  uint32_t bytes;          /**< Bytes on the wire, address bytes included */
+  uint32_t transactions;   /**< Start/address/stop frames */
+} emu_i2c_stats_t;
+
+extern emu_i2c_stats_t emu_i2c_stats;
+
+/** Transactions the i2c queue still accepts before i2c_swamped() reports
+ *  it full, as when the bus is not draining; negative for no limit */
+extern int16_t emu_i2c_room;
+
+
+/**
+ * @brief Detaches all devices, zeroes the clock and the counters and
+ * lifts the i2c queue limit.
+ */
+void emu_reset(void);
+
+
+/**
+ * @brief Attaches an emulated LCD (PCF8574 backpack) at an I2C address.
+ */
+void emu_attach_lcd(uint8_t address, hd44780_emu_t *lcd);
+
+
+/**
+ * @brief Lets simulated time pass, as other firmware work would.
+ */
+void emu_idle_us(uint32_t us);
+
+#endif
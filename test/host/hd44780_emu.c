@@ -0,0 +1,163 @@
+#include <string.h>
+#include "avr_emu.h"
+#include "hd44780_emu.h"
+
+
+//PCF8574 pins
+#define RS_PIN  0x01
+#define RW_PIN  0x02
+#define EN_PIN  0x04
+
+
+void hd44780_emu_reset(hd44780_emu_t *e) {
+  memset(e, 0, sizeof(*e));
+  memset(e->ddram, ' ', sizeof(e->ddram));
+  e->increment = true;
+  e->eight_bit = true;
+  e->busy_until = HD44780_EMU_POWER_ON_US;
+  e->pins = 0xFF;
+}
+
+
+/* Length of a display line (the unit display shift wraps around) */
+static uint8_t line_length(const hd44780_emu_t *e) {
+  return e->two_line ? 40 : 80;
+}
+
+
+/* Address counter after a DDRAM access, following the 2-line jumps */
+static uint8_t next_ddram(const hd44780_emu_t *e, uint8_t ac, bool inc) {
+  if (e->two_line) {
+    if (inc) {
+      return (ac == 0x27) ? 0x40 : (ac == 0x67) ? 0x00 : ac + 1;
+    }
+    return (ac == 0x40) ? 0x27 : (ac == 0x00) ? 0x67 : ac - 1;
+  }
+  if (inc) {
+    return (ac == 0x4F) ? 0x00 : ac + 1;
+  }
+  return (ac == 0x00) ? 0x4F : ac - 1;
+}
+
+
+static void shift_display(hd44780_emu_t *e, bool left) {
+  const uint8_t len = line_length(e);
+  e->shift = left ? (e->shift + 1) % len : (e->shift + len - 1) % len;
+}
+
+
+static void command(hd44780_emu_t *e, uint8_t v) {
+  if (v & 0x80) {                 //Set DDRAM address
+    e->ac = v & 0x7F;
+    e->cgram_mode = false;
+  } else if (v & 0x40) {          //Set CGRAM address
+    e->ac = v & 0x3F;
+    e->cgram_mode = true;
+  } else if (v & 0x20) {          //Function set
+    e->eight_bit = v & 0x10;
+    e->two_line = v & 0x08;
+  } else if (v & 0x10) {          //Cursor or display shift
+    if (v & 0x08) {
+      shift_display(e, !(v & 0x04));
+    } else {
+      e->ac = next_ddram(e, e->ac, v & 0x04);
+    }
+  } else if (v & 0x08) {          //Display control
+    e->display_on = v & 0x04;
+    e->cursor_on = v & 0x02;
+    e->blink_on = v & 0x01;
+  } else if (v & 0x04) {          //Entry mode set
+    e->increment = v & 0x02;
+    e->autoscroll = v & 0x01;
+  } else if (v & 0x02) {          //Return home
+    e->ac = 0;
+    e->shift = 0;
+    e->cgram_mode = false;
+  } else if (v & 0x01) {          //Clear display
+    memset(e->ddram, ' ', sizeof(e->ddram));
+    e->ac = 0;
+    e->shift = 0;
+    e->increment = true;
+    e->cgram_mode = false;
+  }
+}
+
+
+static void data(hd44780_emu_t *e, uint8_t v) {
+  if (e->cgram_mode) {
+    e->cgram[e->ac & 0x3F] = v;
+    e->ac = (e->increment ? e->ac + 1 : e->ac - 1) & 0x3F;
+    return;
+  }
+  e->ddram[e->ac & 0x7F] = v;
+  e->ac = next_ddram(e, e->ac, e->increment);
+  if (e->autoscroll) {
+    shift_display(e, e->increment);
+  }
+}
+
+
+static void execute(hd44780_emu_t *e, bool rs, uint8_t v) {
+  if (emu_clock_us < e->busy_until) {
+    e->violations++;
+    return;
+  }
+  e->instructions++;
+  if (rs) {
+    data(e, v);
+    e->busy_until = emu_clock_us + HD44780_EMU_EXEC_US;
+  } else {
+    command(e, v);
+    e->busy_until = emu_clock_us +
+      ((v <= 0x03) ? HD44780_EMU_SLOW_US : HD44780_EMU_EXEC_US);
+  }
+}
+
+
+void hd44780_emu_write(hd44780_emu_t *e, uint8_t pins) {
+  const uint8_t prev = e->pins;
+  e->pins = pins;
+  if (!(prev & EN_PIN) || (pins & EN_PIN)) {
+    return;   //Only EN falling edges latch
+  }
+
+  const bool rs = prev & RS_PIN;
+  const uint8_t d = prev & 0xF0;
+  if (prev & RW_PIN) {
+    if (!e->eight_bit) {
+      e->read_low = !e->read_low;
+    }
+  } else if (e->eight_bit) {
+    execute(e, rs, d);            //D3-D0 are not wired: read as 0
+  } else if (!e->nibble_pending) {
+    e->nibble = d;
+    e->nibble_pending = true;
+  } else {
+    e->nibble_pending = false;
+    execute(e, rs, e->nibble | (d >> 4));
+  }
+}
+
+
+uint8_t hd44780_emu_read(hd44780_emu_t *e) {
+  uint8_t pins = e->pins;
+  if ((pins & RW_PIN) && (pins & EN_PIN) && !(pins & RS_PIN)) {
+    const uint8_t v = ((emu_clock_us < e->busy_until) ? 0x80 : 0x00) | (e->ac & 0x7F);
+    const uint8_t out = (e->read_low && !e->eight_bit) ? (uint8_t)(v << 4) : (v & 0xF0);
+    pins = (pins & 0x0F) | (pins & out & 0xF0);  //Quasi-bidirectional: LCD pulls down
+  }
+  return pins;
+}
+
+
+void hd44780_emu_row(const hd44780_emu_t *e, uint8_t row, uint8_t cols, char *buf) {
+  static const uint8_t offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+  const uint8_t len = line_length(e);
+  const uint8_t line = offsets[row & 0x03] & 0x40;
+  const uint8_t start = offsets[row & 0x03] & 0x3F;
+
+  for (uint8_t c = 0; c < cols; c++) {
+    buf[c] = e->ddram[line + (start + c + e->shift) % len];
+  }
+  buf[cols] = '\0';
+}
@@ -0,0 +1,72 @@
+/** @file hd44780_emu.h
+ *  @brief Host model of an HD44780 LCD behind a PCF8574 I2C expander.
+ *
+ *  The model consumes the expander pin writes (RS=P0, RW=P1, EN=P2,
+ *  backlight=P3, D7-D4=P7-P4) and latches nibbles on EN falling edges,
+ *  so it accepts exactly what the real panel would. It keeps DDRAM,
+ *  CGRAM, entry mode, display control and shift, and the busy time of
+ *  every instruction measured on the simulated clock of avr_emu.h.
+ */
+
+#ifndef HD44780_EMU_H
+#define HD44780_EMU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HD44780_EMU_POWER_ON_US  40000  /**< Controller ignores writes before this time */
+#define HD44780_EMU_EXEC_US      37     /**< Execution time of most instructions */
+#define HD44780_EMU_SLOW_US      1520   /**< Execution time of clear and return home */
+
+
+typedef struct {
+  uint8_t ddram[0x80];
+  uint8_t cgram[0x40];
+  uint8_t ac;             /**< Address counter */
+  bool cgram_mode;        /**< `ac` points to CGRAM */
+  bool increment;         /**< Entry mode I/D */
+  bool autoscroll;        /**< Entry mode S */
+  bool display_on, cursor_on, blink_on;
+  uint8_t shift;          /**< Display shift, in characters to the left */
+  bool eight_bit;
+  bool two_line;
+  bool nibble_pending;    /**< High nibble of a 4-bit write already latched */
+  uint8_t nibble;
+  bool read_low;          /**< Next 4-bit read returns the low nibble */
+  uint32_t busy_until;    /**< Simulated time when the busy flag clears */
+  uint8_t pins;           /**< PCF8574 output latch */
+
+  uint32_t instructions;  /**< Executed commands and data writes */
+  uint32_t violations;    /**< Writes while busy (dropped, as on real panels) */
+} hd44780_emu_t;
+
+
+/**
+ * @brief Puts the model in its power on state (8-bit interface, blank DDRAM).
+ */
+void hd44780_emu_reset(hd44780_emu_t *e);
+
+
+/**
+ * @brief A byte written to the PCF8574.
+ */
+void hd44780_emu_write(hd44780_emu_t *e, uint8_t pins);
+
+
+/**
+ * @brief A byte read from the PCF8574. While RW and EN are high, D7-D4
+ * are driven by the controller with the busy flag and address counter.
+ */
+uint8_t hd44780_emu_read(hd44780_emu_t *e);
+
+
+/**
+ * @brief Copies the visible characters of a row, honouring display shift.
+ *
+ * @param row Row of a 20x4 style layout (offsets 0x00, 0x40, 0x14, 0x54)
+ * @param cols Number of characters to copy
+ * @param buf Destination, `cols + 1` bytes, NUL terminated
+ */
+void hd44780_emu_row(const hd44780_emu_t *e, uint8_t row, uint8_t cols, char *buf);
+
+#endif
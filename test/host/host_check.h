@@ -0,0 +1,36 @@
+/** @file host_check.h
+ *  @brief Failure counting shared by the host tests. Each test program
+ *  includes it once and exits with check_summary().
+ */
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+static int failures;
+
+
+/**
+ * @brief Counts and reports a failed check.
+ * @param ok The check passed
+ * @param what What was checked
+ */
+static void check(int ok, const char *what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+
+/**
+ * @brief Prints the result line.
+ * @return The number of failed checks, to exit with
+ */
+static int check_summary(void) {
+  printf("%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures;
+}
+
+#endif
@@ -0,0 +1,8 @@
+/* Host shim */
+#ifndef AVR_INTERRUPT_H
+#define AVR_INTERRUPT_H
+
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,9 @@
+/* Host shim: only what the drivers use besides the registers */
+#ifndef AVR_IO_H
+#define AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#endif
@@ -0,0 +1,15 @@
+/* Host shim: program memory is ordinary memory */
+#ifndef AVR_PGMSPACE_H
+#define AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P                const char *
+#define PSTR(s)              (s)
+#define pgm_read_byte(p)     (*(const uint8_t *)(p))
+#define pgm_read_word(p)     (*(const uint16_t *)(p))
+#define strlen_P(s)          strlen(s)
+
+#endif
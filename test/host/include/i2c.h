@@ -0,0 +1,27 @@
+/* Host shim of the libaire i2c module, served by the emulated bus of
+ * avr_emu.c. Transactions complete before the call returns.
+ */
+#ifndef I2C_H
+#define I2C_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {Running = 0, Success, Error} i2c_status_t;
+
+void i2c_setup(void);
+void i2c_open(void);
+void i2c_close(void);
+bool i2c_swamped(void);
+
+void i2c_send(uint8_t address, const uint8_t buf[], uint8_t len,
+              volatile i2c_status_t *st);
+void i2c_send_uint8(uint8_t address, uint8_t value, volatile i2c_status_t *st);
+void i2c_receive(uint8_t address, uint8_t buf[], uint8_t len,
+                 volatile i2c_status_t *st);
+void i2c_receive_uint8(uint8_t address, uint8_t *value,
+                       volatile i2c_status_t *st);
+void i2c_sandr(uint8_t address, const uint8_t sbuf[], uint8_t slen,
+               uint8_t rbuf[], uint8_t rlen, volatile i2c_status_t *st);
+
+#endif
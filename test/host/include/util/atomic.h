@@ -0,0 +1,9 @@
+/* Host shim: there are no interrupts to block */
+#ifndef UTIL_ATOMIC_H
+#define UTIL_ATOMIC_H
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      0
+#define ATOMIC_BLOCK(type)  for (int _atomic_once = 1; _atomic_once; _atomic_once = 0)
+
+#endif
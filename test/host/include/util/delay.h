@@ -0,0 +1,8 @@
+/* Host shim: delays advance the simulated clock of avr_emu.c */
+#ifndef UTIL_DELAY_H
+#define UTIL_DELAY_H
+
+void _delay_ms(double ms);
+void _delay_us(double us);
+
+#endif
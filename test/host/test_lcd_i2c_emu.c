@@ -0,0 +1,647 @@
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "avr_emu.h"
+#include "hd44780_emu.h"
+#include "lcd_i2c.h"
+#include "lcd_render.h"
+#include "lcd_bus.h"
+#include "host_check.h"
+
+/**
+ * @brief Runs `lcd_i2c` scenarios against the emulated panel, checks
+ * what the screen shows and reports the bus cost of each operation.
+ * Exits with the number of failed checks.
+ */
+
+
+#define LCD_I2C_ADDRESS 0x3F
+#define LCD_ROWS        4
+#define LCD_COLS        20
+
+static hd44780_emu_t panel;
+
+
+/* Bus counters at the start of the current operation */
+static emu_i2c_stats_t op_stats;
+static uint32_t op_clock;
+
+static void op_begin(void) {
+  op_stats = emu_i2c_stats;
+  op_clock = emu_clock_us;
+}
+
+static void op_end(const char *name) {
+  printf("  %-34s %5lu bytes %4lu trans %7lu us\n", name,
+         (unsigned long)(emu_i2c_stats.bytes - op_stats.bytes),
+         (unsigned long)(emu_i2c_stats.transactions - op_stats.transactions),
+         (unsigned long)(emu_clock_us - op_clock));
+}
+
+
+static void check_row(uint8_t row, const char *expected) {
+  char buf[LCD_COLS + 1];
+  char padded[LCD_COLS + 1];
+
+  hd44780_emu_row(&panel, row, LCD_COLS, buf);
+  snprintf(padded, sizeof(padded), "%-*s", LCD_COLS, expected);
+  if (strcmp(buf, padded) != 0) {
+    printf("FAIL: row %u is \"%s\", expected \"%s\"\n", row, buf, padded);
+    failures++;
+  }
+}
+
+
+/* Fresh panel and a driver initialized through the async state machine */
+static lcd_t setup(lcd_pacing_t pacing) {
+  lcd_t l = lcd_constructor(LCD_I2C_ADDRESS, LCD_ROWS);
+
+  emu_reset();
+  hd44780_emu_reset(&panel);
+  emu_attach_lcd(LCD_I2C_ADDRESS, &panel);
+
+  lcd_init_start(&l);
+  while (!lcd_init_step(&l, emu_clock_us / 1000)) {
+    emu_idle_us(100);   //Rest of the firmware initializing
+  }
+  lcd_set_pacing(&l, pacing);
+  return l;
+}
+
+
+static void test_init(void) {
+  puts("init");
+  lcd_t l = setup(LCD_PACE_DELAY);
+
+  printf("  %-34s %7lu us\n", "async init until ready", (unsigned long)emu_clock_us);
+  check(panel.violations == 0, "init respects controller timings");
+  check(panel.display_on && !panel.cursor_on && !panel.blink_on, "display on, no cursor");
+  check(!panel.eight_bit && panel.two_line, "4-bit, 2-line mode");
+  check(panel.increment && !panel.autoscroll, "left to right entry mode");
+  check_row(0, "");
+  (void)l;
+}
+
+
+static void test_print(void) {
+  puts("print");
+  lcd_t l = setup(LCD_PACE_DELAY);
+
+  op_begin();
+  lcd_print(&l, "Hi! This is a");
+  op_end("print 13 chars");
+
+  op_begin();
+  lcd_move_cursor(&l, 0, 1);
+  op_end("move cursor");
+
+  lcd_print(&l, "string!");
+  lcd_move_cursor(&l, 17, 0);
+  lcd_print_ch(&l, 'E');
+  lcd_print(&l, "nd");
+
+  op_begin();
+  lcd_move_cursor(&l, 0, 2);   //Row 2 starts where row 0 ends in DDRAM
+  op_end("redundant move cursor");
+
+  check_row(0, "Hi! This is a    End");
+  check_row(1, "string!");
+  check(emu_i2c_stats.bytes == op_stats.bytes, "move to the current address sends nothing");
+  check(panel.violations == 0, "no writes while busy");
+}
+
+
+static void test_entry_modes(void) {
+  puts("entry modes");
+  lcd_t l = setup(LCD_PACE_DELAY);
+
+  lcd_move_cursor(&l, 8, 0);
+  lcd_set_right_to_left(&l);
+  lcd_print(&l, "SDROWKCAB");
+  lcd_set_left_to_right(&l);
+  lcd_print(&l, "x");
+
+  check_row(0, "BACKWORDS");
+  check(panel.ddram[0x67] == 'x', "right to left wraps from 0x00 to 0x67");
+
+  //A cursor shift moves the address counter: moving back is not a no-op
+  lcd_move_cursor(&l, 0, 1);
+  lcd_print(&l, "ab");
+  hd44780_shift(&l.hd, LCD_CURSORMOVE | LCD_MOVERIGHT);
+  lcd_move_cursor(&l, 2, 1);
+  lcd_print(&l, "c");
+  hd44780_shift(&l.hd, LCD_CURSORMOVE | LCD_MOVELEFT);
+  hd44780_shift(&l.hd, LCD_CURSORMOVE | LCD_MOVELEFT);
+  lcd_move_cursor(&l, 1, 1);
+  lcd_print(&l, "B");
+  check_row(1, "aBc");
+}
+
+
+static void test_pacing(void) {
+  puts("pacing");
+  lcd_t l = setup(LCD_PACE_DELAY);
+
+  lcd_print(&l, "garbage");
+  op_begin();
+  lcd_clear(&l, true);
+  op_end("clear (fixed 2ms delay)");
+  lcd_print(&l, "delay");
+  check_row(0, "delay");
+
+  lcd_t b = setup(LCD_PACE_BUSY_FLAG);
+  lcd_print(&b, "garbage");
+  op_begin();
+  lcd_clear(&b, true);
+  op_end("clear (busy flag)");
+  lcd_print(&b, "busy flag");
+  check_row(0, "busy flag");
+
+  op_begin();
+  lcd_return_home(&b, false);
+  lcd_print(&b, "B");
+  op_end("home (non blocking) + print");
+  check_row(0, "Busy flag");
+  check(panel.violations == 0, "busy flag pacing never writes while busy");
+}
+
+
+/* A full i2c queue while a slow command is pending: polling must return */
+static void test_swamped(void) {
+  puts("full i2c queue");
+  lcd_t l = setup(LCD_PACE_BUSY_FLAG);
+
+  lcd_clear(&l, false);
+  lcd_try_print(&l, "queued");
+  op_begin();
+  emu_i2c_room = 0;
+  check(!lcd_poll(&l), "poll returns while the i2c queue is full");
+  check(emu_i2c_stats.transactions == op_stats.transactions, "nothing queued without room");
+  emu_i2c_room = 1;
+  lcd_poll(&l);
+  check(emu_i2c_stats.transactions == op_stats.transactions + 1, "busy flag read queued as room appears");
+  emu_i2c_room = -1;
+  while (!lcd_poll(&l));
+  check_row(0, "queued");
+  check(panel.violations == 0, "no writes while busy");
+}
+
+
+static void test_shadow(void) {
+  static lcd_shadow_t shadow;
+  char line[LCD_COLS + 1];
+
+  puts("shadow");
+  lcd_t l = setup(LCD_PACE_DELAY);
+  lcd_attach_shadow(&l, &shadow, LCD_COLS);
+
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    lcd_move_cursor(&l, 0, row);
+    snprintf(line, sizeof(line), "Row %u: status OK   ", row);
+    lcd_print(&l, line);
+  }
+  op_begin();
+  lcd_flush(&l);
+  op_end("flush full screen");
+  check_row(2, "Row 2: status OK");
+
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    lcd_move_cursor(&l, 0, row);
+    snprintf(line, sizeof(line), "Row %u: status %s", row, row == 1 ? "KO   " : "OK   ");
+    lcd_print(&l, line);
+  }
+  op_begin();
+  lcd_flush(&l);
+  op_end("flush after redraw, 2 cells changed");
+  check_row(1, "Row 1: status KO");
+  check_row(3, "Row 3: status OK");
+
+  op_begin();
+  lcd_flush(&l);
+  op_end("flush with nothing changed");
+  check(emu_i2c_stats.bytes == op_stats.bytes, "clean flush sends nothing");
+}
+
+
+/* A screen composed the usual way: clear, then print every row */
+static void draw_screen(lcd_t *l, const char *status) {
+  char line[LCD_COLS + 1];
+
+  lcd_clear(l, true);
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    lcd_move_cursor(l, 0, row);
+    snprintf(line, sizeof(line), "Row %u: status %s", row, row == 1 ? status : "OK");
+    lcd_print(l, line);
+  }
+}
+
+
+static void test_page(void) {
+  static lcd_page_t page;
+  static lcd_shadow_t shadow;
+
+  puts("double-buffered page");
+  lcd_t l = setup(LCD_PACE_DELAY);
+  lcd_attach_page(&l, &page, LCD_COLS);
+
+  draw_screen(&l, "OK");
+  op_begin();
+  lcd_present(&l);
+  op_end("present first page");
+  check_row(1, "Row 1: status OK");
+
+  const uint32_t instructions = panel.instructions;
+  draw_screen(&l, "KO");
+  check_row(1, "Row 1: status OK");   //Nothing shown before lcd_present()
+  op_begin();
+  lcd_present(&l);
+  op_end("present clear+redraw, 2 changed");
+  check_row(1, "Row 1: status KO");
+  check_row(3, "Row 3: status OK");
+  check(panel.instructions - instructions == 3, "only the changed cells are sent, no clear");
+
+  //The same redraw on a plain shadow resends every cell the clear touched
+  lcd_attach_shadow(&l, &shadow, LCD_COLS);
+  draw_screen(&l, "OK");
+  lcd_flush(&l);
+  draw_screen(&l, "KO");
+  op_begin();
+  lcd_flush(&l);
+  op_end("shadow flush of the same redraw");
+}
+
+
+static void test_glyphs(void) {
+  static lcd_glyph_cache_t glyphs;
+  static const uint8_t bell[8] = {0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00};
+
+  puts("glyph cache");
+  lcd_t l = setup(LCD_PACE_DELAY);
+  lcd_attach_glyph_cache(&l, &glyphs);
+
+  op_begin();
+  const uint8_t slot = lcd_glyph(&l, bell);
+  op_end("glyph upload");
+  check(memcmp(&panel.cgram[slot * 8], bell, 8) == 0, "glyph in CGRAM");
+
+  op_begin();
+  check(lcd_glyph(&l, bell) == slot, "resident glyph keeps its slot");
+  op_end("resident glyph");
+  check(emu_i2c_stats.bytes == op_stats.bytes, "resident glyph is not uploaded again");
+
+  //Same CRC-CCITT as the bell: a different glyph all the same
+  static const uint8_t twin[8] = {0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x11, 0x0C, 0x01};
+  const uint8_t other = lcd_glyph(&l, twin);
+  check(other != slot, "glyph with the same CRC gets its own slot");
+  check(memcmp(&panel.cgram[other * 8], twin, 8) == 0, "glyph with the same CRC in CGRAM");
+  check(lcd_glyph(&l, bell) == slot, "first glyph still resident");
+}
+
+
+/*
+ * Row of the panel with each cell classified by its bitmap: ' ' blank,
+ * '#' full, 'U'/'L'/'D' upper/lower/both half blocks, '1'-'4' columns
+ * lit from the left, 'a'-'g' 1-7 rows lit from the bottom, '?' other.
+ */
+static void check_cells(uint8_t row, const char *expected) {
+  char buf[LCD_COLS + 1];
+  char padded[LCD_COLS + 1];
+
+  hd44780_emu_row(&panel, row, LCD_COLS, buf);
+  for (uint8_t c = 0; c < LCD_COLS; c++) {
+    const uint8_t code = buf[c];
+    uint8_t bits[8];
+    uint8_t rows = 0;
+
+    if (code < 0x10) {
+      memcpy(bits, &panel.cgram[(code & 0x07) * 8], 8);
+    } else {
+      memset(bits, (code == 0xFF) ? 0x1F : 0x00, 8);
+    }
+    for (uint8_t i = 0; i < 8; i++) {
+      if (bits[i] == 0x1F)
+        rows |= 1 << i;
+    }
+
+    char cell = '?';
+    if (!memcmp(bits, "\0\0\0\0\0\0\0\0", 8)) {
+      cell = ' ';
+    } else if (rows == 0xFF) {
+      cell = '#';
+    } else if (rows == 0x03 || rows == 0xC0 || rows == 0xC3) {
+      cell = (rows == 0x03) ? 'U' : (rows == 0xC0) ? 'L' : 'D';
+    } else if (rows && rows == (uint8_t)(0xFF << (__builtin_ctz(rows)))) {
+      cell = 'a' + 7 - __builtin_ctz(rows);
+    } else {
+      for (uint8_t n = 1; n < 5; n++) {
+        if (bits[0] == (0x1F & ~(0x1F >> n)) && !memcmp(bits, bits + 1, 7))
+          cell = '0' + n;
+      }
+    }
+    buf[c] = cell;
+  }
+  snprintf(padded, sizeof(padded), "%-*s", LCD_COLS, expected);
+  if (strcmp(buf, padded) != 0) {
+    printf("FAIL: row %u cells are \"%s\", expected \"%s\"\n", row, buf, padded);
+    failures++;
+  }
+}
+
+
+static void test_render(void) {
+  static lcd_glyph_cache_t glyphs;
+  lcd_big_t big;
+  lcd_bar_t hbar, vbar;
+
+  puts("big digits and bars");
+  lcd_t l = setup(LCD_PACE_DELAY);
+  lcd_attach_glyph_cache(&l, &glyphs);
+  lcd_big_init(&big, 0, 0, 2, 3);
+  lcd_bar_init(&hbar, 0, 2, 16, false);
+  lcd_bar_init(&vbar, 19, 3, 2, true);
+
+  op_begin();
+  lcd_big_number(&l, &big, 128);
+  op_end("big number, first draw");
+  check_cells(0, "U#  DD# #D#");
+  check_cells(1, "L#L #LL #L#");
+
+  op_begin();
+  lcd_big_number(&l, &big, 129);
+  op_end("big number, one digit changes");
+  check_cells(0, "U#  DD# #D#");
+  check_cells(1, "L#L #LL LL#");
+
+  op_begin();
+  lcd_big_number(&l, &big, 129);
+  op_end("big number, unchanged");
+  check(emu_i2c_stats.bytes == op_stats.bytes, "unchanged number sends nothing");
+
+  op_begin();
+  lcd_bar_set(&l, &hbar, 37);
+  op_end("bar, first draw");
+  check_cells(2, "#######2");
+
+  op_begin();
+  lcd_bar_set(&l, &hbar, 38);
+  op_end("bar, one pixel more");
+  check_cells(2, "#######3");
+
+  lcd_bar_set(&l, &hbar, 10);
+  check_cells(2, "##");
+
+  op_begin();
+  lcd_bar_set(&l, &vbar, 11);
+  op_end("vertical bar, first draw");
+  check_cells(2, "##                 c");
+  check_cells(3, "                   #");
+
+  //What a 10 Hz refresh of a changing reading and bar costs
+  op_begin();
+  lcd_big_number(&l, &big, 130);
+  lcd_bar_set(&l, &hbar, 11);
+  lcd_bar_set(&l, &vbar, 12);
+  op_end("10 Hz frame: 2 digits and 2 bars");
+  check_cells(0, "U#  DD# #U#");
+  check_cells(1, "L#L LL# #L#");
+  check_cells(2, "##1                d");
+  check(panel.violations == 0, "no writes while busy");
+}
+
+
+static void test_marquee(void) {
+  lcd_marquee_t m;
+
+  puts("marquee");
+  lcd_t l = setup(LCD_PACE_DELAY);
+  lcd_print(&l, "[          ]");
+  lcd_marquee_init(&m, 1, 0, 10, 2);
+  lcd_marquee_set_text_P(&m, PSTR("Scrolling from flash"));
+
+  op_begin();
+  check(lcd_marquee_tick(&l, &m), "window fits in the transmit ring");
+  while (!lcd_poll(&l)) {
+    emu_idle_us(1000);   //Rest of the main loop
+  }
+  op_end("marquee, first window");
+  check_row(0, "[Scrolling ]");
+
+  //Every other tick moves the text one character
+  lcd_marquee_tick(&l, &m);
+  check_row(0, "[Scrolling ]");
+  op_begin();
+  lcd_marquee_tick(&l, &m);
+  op_end("marquee step");
+  check_row(0, "[crolling f]");
+
+  //The text comes back after the gap
+  for (uint8_t i = 0; i < 2 * 18; i++) {
+    lcd_marquee_tick(&l, &m);
+  }
+  check_row(0, "[h   Scroll]");
+  check(panel.shift == 0, "display is not shifted");
+
+  lcd_marquee_set_text(&m, "Short");
+  lcd_marquee_tick(&l, &m);
+  op_begin();
+  for (uint8_t i = 0; i < 10; i++) {
+    lcd_marquee_tick(&l, &m);
+  }
+  op_end("marquee with a fitting text");
+  check_row(0, "[Short     ]");
+  check(emu_i2c_stats.bytes == op_stats.bytes, "fitting text is drawn once");
+}
+
+
+static uint16_t emu_clock_ms(void) {
+  return emu_clock_us / 1000;
+}
+
+
+/* Yield of the panel printing blocking: counts its transactions handed
+ * over outside the scheduler rounds */
+static lcd_t *fair_lcd;
+static uint8_t fair_tail;
+static uint16_t fair_outside;
+
+static void fair_yield(void *b) {
+  if (fair_lcd->ring_tail != fair_tail) {
+    fair_outside++;
+  }
+  lcd_bus_yield(b);
+  fair_tail = fair_lcd->ring_tail;
+}
+
+
+static void test_bus(void) {
+  static hd44780_emu_t panels[4];
+  lcd_t lcds[4] = {
+    lcd_constructor(0x3C, LCD_ROWS), lcd_constructor(0x3D, LCD_ROWS),
+    lcd_constructor(0x3E, LCD_ROWS), lcd_constructor(0x3F, LCD_ROWS)
+  };
+  lcd_bus_t bus;
+  bool ready;
+
+  puts("four panels on one bus");
+  emu_reset();
+  for (uint8_t i = 0; i < 4; i++) {
+    hd44780_emu_reset(&panels[i]);
+    emu_attach_lcd(lcds[i].i2c_address, &panels[i]);
+    lcd_init_start(&lcds[i]);
+  }
+  do {
+    emu_idle_us(100);
+    ready = true;
+    for (uint8_t i = 0; i < 4; i++) {
+      ready &= lcd_init_step(&lcds[i], emu_clock_ms());
+    }
+  } while (!ready);
+
+  lcd_bus_init(&bus, emu_clock_ms);
+  for (uint8_t i = 0; i < 4; i++) {
+    check(lcd_bus_add_lcd(&bus, &lcds[i]) == i, "panel added to the bus");
+  }
+
+  //Panels 1-3 queue a row each, then panel 0 prints a whole screen blocking
+  char row[] = "Queued without block";
+  char screen[] = "A long blocking print that fills all four rows of panel number zero, 80 chars..";
+  for (uint8_t i = 1; i < 4; i++) {
+    lcd_try_print(&lcds[i], row);
+  }
+  fair_lcd = &lcds[0];
+  fair_tail = lcds[0].ring_tail;
+  fair_outside = 0;
+  lcd_set_yield(&lcds[0], fair_yield, &bus);
+  op_begin();
+  lcd_print(&lcds[0], screen);
+  op_end("blocking print on panel 0");
+  check(fair_outside == 0, "blocking panel served only by the rounds");
+  const uint32_t print_us = emu_clock_us - op_clock;
+
+  //The other panels were served while panel 0 waited
+  for (uint8_t i = 1; i < 4; i++) {
+    char buf[LCD_COLS + 1];
+    const lcd_bus_stats_t *s = lcd_bus_stats(&bus, i);
+
+    hd44780_emu_row(&panels[i], 0, LCD_COLS, buf);
+    check(strcmp(buf, row) == 0, "queued row sent during the blocking print");
+    check(!s->pending && s->latency_max * 1000UL < print_us, "latency below the blocking print");
+    printf("  panel %u latency %u ms, %u slices\n", i, s->latency_max, s->slices);
+  }
+  check(lcd_bus_poll(&bus), "bus idle");
+}
+
+
+/* The workloads of bench_lcd_display.c, to get their bus cost */
+static void test_workloads(void) {
+  static const uint8_t bell[8] = {0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00};
+  char row[] = "Row n: benchmarking ";
+  char field[] = "12345";
+
+  puts("workloads (bench_lcd_display)");
+  lcd_t l = setup(LCD_PACE_BUSY_FLAG);
+
+  op_begin();
+  lcd_clear(&l, true);
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    row[4] = '0' + r;
+    lcd_move_cursor(&l, 0, r);
+    lcd_print(&l, row);
+  }
+  op_end("full redraw");
+  check_row(3, "Row 3: benchmarking");
+
+  op_begin();
+  lcd_move_cursor(&l, 15, 1);
+  lcd_print(&l, field);
+  op_end("field update");
+
+  op_begin();
+  lcd_create_char(&l, 0, (uint8_t *)bell);
+  op_end("glyph upload");
+
+  op_begin();
+  for (uint8_t c = 0; c < LCD_COLS; c++) {
+    lcd_move_cursor(&l, c, c & 0x03);
+  }
+  op_end("cursor moves");
+  check(panel.violations == 0, "no writes while busy");
+}
+
+
+static void test_try_print(void) {
+  puts("non-blocking print");
+  lcd_t l = setup(LCD_PACE_DELAY);
+  char text[] = "Forty characters do not fit in the ring";
+  uint8_t sent = lcd_try_print(&l, text);
+
+  check(sent == LCD_RING_SIZE, "ring accepts up to its size");
+  while (text[sent] != '\0' || !lcd_poll(&l)) {
+    sent += lcd_try_print(&l, &text[sent]);
+  }
+  check_row(0, "Forty characters do ");
+  check_row(2, "not fit in the ring");
+
+  //Rows wrap at 4, as with the blocking lcd_move_cursor()
+  lcd_try_move_cursor(&l, 0, 5);
+  lcd_try_print(&l, "F");
+  while (!lcd_poll(&l));
+  lcd_move_cursor(&l, 4, 7);
+  lcd_print(&l, "Y");
+  check_row(1, "F");
+  check_row(3, "    Y");
+}
+
+
+static void test_printf(void) {
+  puts("printf");
+  lcd_t l = setup(LCD_PACE_DELAY);
+
+  op_begin();
+  lcd_printf(&l, "T=%.1fC %4d%%", 215, 42);
+  op_end("printf fixed-point and int fields");
+  lcd_move_cursor(&l, 0, 1);
+  lcd_printf(&l, "%05u|%-4s|%x|%c", 123, "ab", 0xBEEF, '!');
+  lcd_move_cursor(&l, 0, 2);
+  lcd_printf(&l, "%ld %.2f %.3lf", -100000L, -5, 12345L);
+  lcd_move_cursor(&l, 0, 3);
+  lcd_printf(&l, "%03d|%7.2f|%lu", -7, 31415, 40000000UL);
+
+  check_row(0, "T=21.5C   42%");
+  check_row(1, "00123|ab  |beef|!");
+  check_row(2, "-100000 -0.05 12.345");
+  check_row(3, "-07| 314.15|40000000");
+
+  lcd_clear(&l, true);
+  lcd_print_P(&l, PSTR("Menu"));
+  lcd_printf_P(&l, PSTR(" %S:%3d"), PSTR("item"), 7);
+  check_row(0, "Menu item:  7");
+
+  //Precisions above 9 decimals are clamped, not overflowing the digits
+  lcd_move_cursor(&l, 0, 1);
+  lcd_printf(&l, "%.12f|", 5);
+  lcd_move_cursor(&l, 0, 2);
+  lcd_printf(&l, "%.255lf|", -2147483647L);
+  check_row(1, "0.000000005|");
+  check_row(2, "-2.147483647|");
+}
+
+
+int main(void) {
+  test_init();
+  test_print();
+  test_entry_modes();
+  test_pacing();
+  test_swamped();
+  test_shadow();
+  test_page();
+  test_glyphs();
+  test_render();
+  test_marquee();
+  test_bus();
+  test_workloads();
+  test_try_print();
+  test_printf();
+
+  return check_summary();
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include "motor_dda.h"
+#include "host_check.h"
+
+/**
+ * @brief Runs `motor_dda` lines on the host and checks that every axis
+ * stays within half a step of the ideal line on every tick and reaches
+ * its target on the last one, with the dominant axis stepping on every
+ * tick. Exits with the number of failed checks.
+ */
+
+
+static void run(uint16_t dx, uint16_t dy, uint16_t dz) {
+  const uint16_t delta[MOTOR_AXES] = {dx, dy, dz};
+  uint16_t count[MOTOR_AXES] = {0};
+  motor_dda_t d;
+  uint32_t worst = 0;             // worst deviation, in 1/ticks of a step
+  uint8_t dominant = 1;
+
+  const uint16_t ticks = motor_dda_start(&d, delta, MOTOR_AXES);
+  for (uint32_t k = 1; k <= ticks; k++) {
+    const uint8_t mask = motor_dda_next(&d);
+
+    for (uint8_t i = 0; i < MOTOR_AXES; i++) {
+      count[i] += (mask >> i) & 1;
+      //|count - k * delta / ticks|, scaled by ticks
+      const uint32_t ideal = k * delta[i];
+      const uint32_t have = (uint32_t)count[i] * ticks;
+      const uint32_t dev = (have > ideal) ? have - ideal : ideal - have;
+      if (dev > worst)
+        worst = dev;
+      if (delta[i] == ticks && !(mask & (1 << i)))
+        dominant = 0;
+    }
+  }
+
+  printf("  %5u %5u %5u: %5u ticks, worst deviation %.3f steps\n",
+         dx, dy, dz, ticks, ticks ? (double)worst / ticks : 0.0);
+  check(ticks == (dx > dy ? (dx > dz ? dx : dz) : (dy > dz ? dy : dz)), "ticks of the dominant axis");
+  check(count[0] == dx && count[1] == dy && count[2] == dz, "every axis reaches its target");
+  check(2 * worst <= ticks, "within half a step of the line");
+  check(dominant, "the dominant axis steps on every tick");
+}
+
+
+int main(void) {
+  puts("dda lines");
+  run(1000, 1000, 0);         //Diagonal
+  run(1000, 333, 1);          //Shallow
+  run(7, 1000, 999);          //Nearly equal axes
+  run(65535, 65534, 1);       //Longest line: no overflow
+  run(3, 0, 0);               //Single axis
+  run(0, 0, 0);               //Empty
+
+  return check_summary();
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <math.h>
+#include "motor_ramp.c"    // its static helpers are checked as well
+#include "host_check.h"
+
+/**
+ * @brief Runs `motor_ramp` profiles on the host and checks them against
+ * the ideal trapezoid: constant acceleration while ramping, the maximum
+ * speed while cruising and a move time close to the minimum.
+ * The interpolation of the correction tables is checked entry by entry.
+ * S-curve profiles are played into a pulse train whose speed,
+ * acceleration and jerk are measured from the step times, to check that
+ * the speed and the acceleration change without jumps.
+ * Exits with the number of failed checks.
+ */
+
+
+/*
+ * Runs a move and checks it. The acceleration of a step is measured from
+ * the speeds (F / interval, with the fraction the generator keeps)
+ * before and after it: v1^2 - v0^2 = 2 * a. The move time adds the
+ * whole tick intervals actually programmed.
+ */
+static void run(uint16_t steps, uint16_t max_rate, uint16_t accel) {
+  motor_accel_t a;
+  motor_ramp_t r;
+  uint32_t ticks = 0;
+  uint16_t count = 0;
+  double peak = 0, worst = 0;
+
+  motor_ramp_accel(&a, accel);
+  uint16_t p = motor_ramp_start(&r, &a, steps, max_rate);
+  double v0 = 0;
+  while (p) {
+    const double v = (double)MOTOR_RAMP_HZ * 65536 / r.period;
+    ticks += p;
+    count++;
+    //Ramps only: cruising and steps at the start speed are skipped
+    if (v0 > 0 && v != v0 && r.period != r.max_period) {
+      const double err = fabs(fabs(v * v - v0 * v0) / 2 - accel) / accel;
+      if (err > worst)
+        worst = err;
+    }
+    if (v > peak)
+      peak = v;
+    v0 = v;
+    p = motor_ramp_next(&r);
+  }
+
+  //Ideal trapezoid (or triangle) time from standstill to standstill
+  const double vmax = fmin(max_rate, sqrt((double)accel * steps));
+  const double ideal = vmax / accel + steps / vmax;
+  const double t = (double)ticks / MOTOR_RAMP_HZ;
+
+  printf("  %5u steps %5u steps/s %5u steps/s2: peak %6.0f steps/s, accel error %4.1f%%, time %.3fs (ideal %.3fs)\n",
+         steps, max_rate, accel, peak, worst * 100, t, ideal);
+  check(count == steps, "every step is generated");
+  check(worst < 0.05, "constant acceleration within 5%");
+  check(peak <= max_rate * 1.01, "maximum speed is not exceeded");
+  check(t < ideal * 1.05 + 0.04, "move time close to the minimum");
+}
+
+
+/*
+ * Pulse train analysis. Speed and acceleration are finite differences of
+ * the step times over windows of SCURVE_WINDOW steps, which average out
+ * the rounding of every step to a whole tick. The first interval (from
+ * standstill, clamped to the slowest one) and its mirror, the last one,
+ * are not motion between steps and are left out.
+ */
+#define SCURVE_WINDOW 16
+#define SCURVE_MAX_STEPS 2000
+
+static double step_time[SCURVE_MAX_STEPS];
+
+typedef struct {
+  double v, a, j;        // maximum absolute speed, acceleration and jerk
+} train_t;
+
+
+static void analyze(train_t *r, uint16_t n) {
+  static double v[SCURVE_MAX_STEPS], tv[SCURVE_MAX_STEPS];
+  static double a[SCURVE_MAX_STEPS], ta[SCURVE_MAX_STEPS];
+  const uint16_t w = SCURVE_WINDOW;
+
+  //Each difference is dated at the middle of its window
+  r->v = r->a = r->j = 0;
+  for (uint16_t k = 1; k + w + 1 < n; k++) {
+    v[k] = w / (step_time[k + w] - step_time[k]);
+    tv[k] = (step_time[k + w] + step_time[k]) / 2;
+    r->v = fmax(r->v, v[k]);
+  }
+  for (uint16_t k = 1; k + 2 * w + 1 < n; k++) {
+    a[k] = (v[k + w] - v[k]) / (tv[k + w] - tv[k]);
+    ta[k] = (tv[k + w] + tv[k]) / 2;
+    r->a = fmax(r->a, fabs(a[k]));
+  }
+  for (uint16_t k = 1; k + 3 * w + 1 < n; k++) {
+    r->j = fmax(r->j, fabs((a[k + w] - a[k]) / (ta[k + w] - ta[k])));
+  }
+}
+
+
+/*
+ * Plays a move from a generator into step_time[].
+ * @return The number of steps
+ */
+static uint16_t play_ramp(motor_ramp_t *r, uint16_t p) {
+  uint32_t ticks = 0;
+  uint16_t n = 0;
+
+  for (; p && n < SCURVE_MAX_STEPS; p = motor_ramp_next(r)) {
+    ticks += p;
+    step_time[n++] = (double)ticks / MOTOR_RAMP_HZ;
+  }
+  return n;
+}
+
+
+static uint16_t play_scurve(motor_scurve_move_t *m, uint16_t p) {
+  uint32_t ticks = 0;
+  uint16_t n = 0;
+
+  for (; p && n < SCURVE_MAX_STEPS; p = motor_scurve_next(m)) {
+    ticks += p;
+    step_time[n++] = (double)ticks / MOTOR_RAMP_HZ;
+  }
+  return n;
+}
+
+
+/*
+ * Builds an S-curve profile, plays a move with it and checks the pulse
+ * train. The trapezoid of the same acceleration is measured as well:
+ * its corners show up as a jerk far above the limit.
+ */
+static void run_scurve(uint16_t steps, uint16_t max_rate, uint16_t accel, uint32_t jerk,
+                       uint16_t size) {
+  static uint16_t table[SCURVE_MAX_STEPS];
+  motor_scurve_t s;
+  motor_scurve_move_t m;
+  motor_accel_t a;
+  motor_ramp_t r;
+  train_t sc, tr;
+
+  const uint16_t rate = motor_scurve_build(&s, table, size, max_rate, accel, jerk);
+  const uint16_t n = play_scurve(&m, motor_scurve_start(&m, &s, steps, max_rate));
+  analyze(&sc, n);
+
+  motor_ramp_accel(&a, accel);
+  analyze(&tr, play_ramp(&r, motor_ramp_start(&r, &a, steps, rate)));
+
+  printf("  %5u steps %5u steps/s %5u steps/s2 %6lu steps/s3 (table %3u/%3u): "
+         "peak %4.0f steps/s, accel %4.0f, jerk %6.0f (trapezoid %7.0f), time %.3fs\n",
+         steps, max_rate, accel, (unsigned long)jerk, s.steps, size,
+         sc.v, sc.a, sc.j, tr.j, step_time[n - 1]);
+  check(n == steps, "every step is generated");
+  check(s.steps <= size, "the acceleration fits in the table");
+  check(sc.v <= rate * 1.01, "maximum speed is not exceeded");
+  check(sc.a <= accel * 1.02, "maximum acceleration is not exceeded");
+  check(sc.j <= jerk * 1.1, "acceleration changes without jumps");
+  check(tr.j > jerk * 1.5, "trapezoid corners are detected");
+}
+
+
+/*
+ * Every interpolated correction factor must lie between the two table
+ * entries around it. The table slopes go through 16 bits as on AVR, so
+ * a slope that wraps around shows up here.
+ */
+static void check_tables(void) {
+  static const struct {
+    const uint16_t *c;
+    const char *name;
+  } tables[] = {{ramp_accel_c, "accel"}, {ramp_decel_c, "decel"}};
+
+  for (uint8_t t = 0; t < 2; t++) {
+    const uint16_t *c = tables[t].c;
+    uint16_t bad = 0;
+
+    for (uint32_t q = 0; q < 0x10000; q += 7) {
+      const uint8_t i = q >> RAMP_Q_STEP_BITS;
+      const uint16_t lo = (i >= 16) ? c[16] : (c[i] < c[i + 1]) ? c[i] : c[i + 1];
+      const uint16_t hi = (i >= 16) ? c[16] : (c[i] < c[i + 1]) ? c[i + 1] : c[i];
+      const uint16_t f = ramp_interpolate(c, q);
+
+      if (f < lo || f > hi)
+        bad++;
+    }
+    printf("  %s table: %u factor(s) out of range\n", tables[t].name, bad);
+    check(bad == 0, "interpolated factors between the table entries");
+  }
+}
+
+
+int main(void) {
+  puts("correction tables");
+  check_tables();
+
+  puts("trapezoidal ramps");
+  run(2000, 4000, 8000);    //Trapezoid
+  run(200, 4000, 8000);     //Triangle: too short to reach the maximum speed
+  run(20000, 20000, 20000); //Fast
+  run(1000, 400, 1000);     //Slow: starts at the slowest interval
+  run(500, 100, 20000);     //Maximum speed below the start speed
+
+  puts("s-curves");
+  run_scurve(1000, 2000, 8000, 160000, 400);    //Constant acceleration reached
+  run_scurve(2000, 4000, 8000, 40000, 400);     //Speed limited by the table
+  run_scurve(1000, 1000, 20000, 50000, 400);    //Acceleration never reached
+
+  return check_summary();
+}
@@ -1,7 +1,11 @@
+#include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 #include "i2c.h"
 #include "lcd_i2c.h"
+#include "lcd_render.h"
 
 /**
  * @brief This is an example that shows the main functions
@@ -18,9 +22,19 @@
  *  - Enable / disable cursor blinking
  *  - Manual scroll
  *  - Auto scroll
+ *  - Marquee (non-blocking scrolling inside a window)
  *  - Left to right writing
  *  - Right to left writing
  *  - Custom characters
+ *  - Shadow framebuffer
+ *  - Non-blocking printing
+ *  - Glyph cache
+ *  - Big digits and bar graphs
+ *
+ * Labels are printed straight from flash with `lcd_print_P`. Build with
+ * `-DLABELS_IN_RAM` to print them from SRAM with `lcd_print` instead,
+ * and compare the `.data` size reported by `make size_test_lcd_i2c`
+ * for both builds to see the SRAM saved.
  */
 
 
@@ -30,34 +44,73 @@
 //There are some different-sized LCD's based on the same HD44780 driver.
 //Insert how many rows it has:
 #define LCD_ROWS        4
+//and how many columns:
+#define LCD_COLS        20
+
+#ifdef LABELS_IN_RAM
+#define PRINT_LABEL(l, s) lcd_print(l, s)
+#else
+#define PRINT_LABEL(l, s) lcd_print_P(l, PSTR(s))
+#endif
+
+static lcd_shadow_t shadow;
+static lcd_glyph_cache_t glyphs;
+
+
+//Millisecond clock (Timer0, CTC mode) to pace the asynchronous LCD init
+static volatile uint16_t ms_ticks;
+
+ISR(TIMER0_COMPA_vect) {
+  ms_ticks++;
+}
+
+static void ms_clock_setup(void) {
+  TCCR0A = _BV(WGM01);                 //CTC
+  OCR0A = F_CPU / 64 / 1000 - 1;       //1ms period
+  TIMSK0 = _BV(OCIE0A);
+  TCCR0B = _BV(CS01) | _BV(CS00);      //clk/64
+}
+
+static uint16_t ms_clock(void) {
+  uint16_t t;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    t = ms_ticks;
+  }
+  return t;
+}
+
 
 int main(){
   lcd_t lcd = lcd_constructor(LCD_I2C_ADDRESS, LCD_ROWS);
+  ms_clock_setup();
   i2c_setup();
 
   sei();
 
   i2c_open();
 
-  _delay_ms(50);
-  lcd_init(&lcd);
+  //No need to wait for power on: other devices would be set up in this loop
+  lcd_init_start(&lcd);
+  while (!lcd_init_step(&lcd, ms_clock()));
+  //The PCF8574 backpack wires RW, so slow commands can be paced by the busy flag
+  lcd_set_pacing(&lcd, LCD_PACE_BUSY_FLAG);
 
   
   for(;;) {    
     //Printed strings
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Hi! This is a");
+    PRINT_LABEL(&lcd, "Hi! This is a");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "string!");
+    PRINT_LABEL(&lcd, "string!");
 
     _delay_ms(2000);
 
 
     //Clear display
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Now, I cleared");
+    PRINT_LABEL(&lcd, "Now, I cleared");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "the display");
+    PRINT_LABEL(&lcd, "the display");
 
     _delay_ms(2000);
 
@@ -79,23 +132,23 @@ int main(){
     lcd_print_ch(&lcd, ' ');
     _delay_ms(200);    
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "the cursor.");
+    PRINT_LABEL(&lcd, "the cursor.");
 
     _delay_ms(2000);
     
 
     //Return home
     lcd_return_home(&lcd, true);
-    lcd_print(&lcd, "I just ");
+    PRINT_LABEL(&lcd, "I just ");
     _delay_ms(500);
-    lcd_print(&lcd, "returned");
+    PRINT_LABEL(&lcd, "returned");
     lcd_move_cursor(&lcd, 0, 1);
     _delay_ms(500);
-    lcd_print(&lcd, "home ");    
+    PRINT_LABEL(&lcd, "home ");    
     _delay_ms(500);
-    lcd_print(&lcd, "sweet ");    
+    PRINT_LABEL(&lcd, "sweet ");    
     _delay_ms(500);
-    lcd_print(&lcd, "home");   
+    PRINT_LABEL(&lcd, "home");   
 
     _delay_ms(2000);
 
@@ -116,9 +169,9 @@ int main(){
 
     //Cursor display
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Let's see");
+    PRINT_LABEL(&lcd, "Let's see");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "the cursor");
+    PRINT_LABEL(&lcd, "the cursor");
     _delay_ms(1000);
     lcd_enable_cursor(&lcd);
 
@@ -127,9 +180,9 @@ int main(){
 
     //Cursor blinking
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Let's blink");
+    PRINT_LABEL(&lcd, "Let's blink");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "the cursor");
+    PRINT_LABEL(&lcd, "the cursor");
     lcd_enable_blinking(&lcd);
 
     _delay_ms(4000);
@@ -139,9 +192,9 @@ int main(){
 
     //Display on & off
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Let's shut off");
+    PRINT_LABEL(&lcd, "Let's shut off");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "the display 2s");
+    PRINT_LABEL(&lcd, "the display 2s");
     _delay_ms(2000);
     lcd_off(&lcd);
     _delay_ms(2000);
@@ -152,16 +205,16 @@ int main(){
 
     //Manual scroll
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Manual scrolling");
+    PRINT_LABEL(&lcd, "Manual scrolling");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "LEFT  <- 5 TIMES");
+    PRINT_LABEL(&lcd, "LEFT  <- 5 TIMES");
     for(uint8_t i = 0; i<5; i++){
       _delay_ms(1000);
       lcd_scroll_left(&lcd);
     }
     _delay_ms(2000);
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "RIGHT -> 5 TIMES");
+    PRINT_LABEL(&lcd, "RIGHT -> 5 TIMES");
     for(uint8_t i = 0; i<5; i++){
       _delay_ms(1000);
       lcd_scroll_right(&lcd);
@@ -171,7 +224,7 @@ int main(){
 
     //Autoscrolling
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, " Scrolling test");
+    PRINT_LABEL(&lcd, " Scrolling test");
     lcd_enable_cursor(&lcd);            //In autoscroll mode, cursor should be enabled. Otherwise the autoscroll moves backwords.
     lcd_enable_autoscroll(&lcd);
     lcd_move_cursor(&lcd, 15, 1);
@@ -186,11 +239,38 @@ int main(){
     _delay_ms(2000);
 
 
+    //Marquee: a window of row 1 scrolls every 300ms while the loop keeps running
+    lcd_clear(&lcd, true);
+    PRINT_LABEL(&lcd, "Marquee");
+    {
+      lcd_marquee_t marquee;
+      const uint16_t start = ms_clock();
+      uint16_t tick = start;
+
+      lcd_move_cursor(&lcd, 0, 1);
+      lcd_print_ch(&lcd, '[');
+      lcd_move_cursor(&lcd, LCD_COLS - 1, 1);
+      lcd_print_ch(&lcd, ']');
+      lcd_marquee_init(&marquee, 1, 1, LCD_COLS - 2, 6);
+      lcd_marquee_set_text_P(&marquee, PSTR("Only this window is rewritten, nothing waits for it"));
+      while ((uint16_t)(ms_clock() - start) < 10000) {
+        if ((uint16_t)(ms_clock() - tick) >= 50) {   //50ms tick
+          tick += 50;
+          lcd_marquee_tick(&lcd, &marquee);
+        }
+        lcd_poll(&lcd);
+        //...other work of the main loop
+      }
+    }
+
+    _delay_ms(2000);
+
+
     //Create char
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "Let's create");
+    PRINT_LABEL(&lcd, "Let's create");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "a char!");
+    PRINT_LABEL(&lcd, "a char!");
     _delay_ms(2000);
     uint8_t U_char[8] = {
       0b11011,
@@ -206,12 +286,88 @@ int main(){
     lcd_create_char(&lcd, mem_index, U_char);
     _delay_ms(1000);
     lcd_clear(&lcd, true);
-    lcd_print(&lcd, "That's a bold");
+    PRINT_LABEL(&lcd, "That's a bold");
     lcd_move_cursor(&lcd, 0, 1);
-    lcd_print(&lcd, "custom one: ");
+    PRINT_LABEL(&lcd, "custom one: ");
     lcd_print_ch(&lcd, mem_index);
 
     _delay_ms(4000);
+
+
+    //Shadow framebuffer: only changed cells reach the display
+    lcd_attach_shadow(&lcd, &shadow, LCD_COLS);
+    lcd_clear(&lcd, false);
+    PRINT_LABEL(&lcd, "Shadow counter:");
+    for (uint8_t i = 0; i < 10; i++) {
+      lcd_move_cursor(&lcd, 0, 1);
+      PRINT_LABEL(&lcd, "Count: ");
+      lcd_print_ch(&lcd, '0' + i);
+      lcd_flush(&lcd);             //Only the digit is sent after the 1st flush
+      _delay_ms(500);
+    }
+    lcd_attach_shadow(&lcd, NULL, 0);
+
+    _delay_ms(2000);
+
+
+    //Non-blocking printing: the loop keeps running while the LCD is fed
+    lcd_clear(&lcd, true);
+    char nb[] = "Printed without ever blocking the main loop";
+    uint8_t sent = 0;
+    uint16_t spins = 0;
+    while (nb[sent] != '\0' || !lcd_poll(&lcd)) {
+      sent += lcd_try_print(&lcd, &nb[sent]);
+      spins++;                     //Other work would be done here
+    }
+    lcd_move_cursor(&lcd, 0, 3);
+    if (spins > 1) {
+      PRINT_LABEL(&lcd, "(spun meanwhile)");
+    } else {
+      PRINT_LABEL(&lcd, "(single pass)");
+    }
+
+    _delay_ms(2000);
+
+
+    //Glyph cache: a bar that grows pixel by pixel, uploading each glyph once
+    lcd_attach_glyph_cache(&lcd, &glyphs);
+    lcd_clear(&lcd, true);
+    PRINT_LABEL(&lcd, "Cached glyphs");
+    for (uint8_t round = 0; round < 3; round++) {
+      for (uint8_t px = 1; px <= 5; px++) {
+        uint8_t bar[8];
+        for (uint8_t r = 0; r < 8; r++) {
+          bar[r] = (0x1F << (5 - px)) & 0x1F;
+        }
+        const uint8_t ch = lcd_glyph(&lcd, bar);  //Only uploads in the 1st round
+        lcd_move_cursor(&lcd, 0, 1);
+        lcd_print_ch(&lcd, ch);
+        _delay_ms(200);
+      }
+    }
+    lcd_attach_glyph_cache(&lcd, NULL);
+
+    _delay_ms(2000);
+
+
+    //Big digits and bars: a 10 Hz counter redrawing only what changes
+    lcd_attach_glyph_cache(&lcd, &glyphs);
+    lcd_clear(&lcd, true);
+    {
+      lcd_big_t big;
+      lcd_bar_t bar;
+
+      lcd_big_init(&big, 0, 0, 2, 3);
+      lcd_bar_init(&bar, 0, 3, LCD_COLS, false);
+      for (uint8_t count = 0; count <= LCD_COLS * 5; count++) {
+        lcd_big_number(&lcd, &big, count);
+        lcd_bar_set(&lcd, &bar, count);
+        _delay_ms(100);
+      }
+    }
+    lcd_attach_glyph_cache(&lcd, NULL);
+
+    _delay_ms(2000);
   }
 
   i2c_close();
@@ -0,0 +1,61 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include "i2c.h"
+#include "lcd_i2c.h"
+#include "hd44780_par.h"
+
+/**
+ * @brief Example driving two displays on different buses from the same
+ * program: one behind a PCF8574 I2C expander (`lcd_i2c`) and one on a
+ * 4-bit parallel bus (`hd44780_par`). Both drivers build their commands
+ * with the HD44780 core, which is linked only once.
+ *
+ * `make flash_report` prints the flash used by each LCD module and by
+ * this program.
+ */
+
+
+//I2C display
+#define LCD_I2C_ADDRESS 0x3F
+#define LCD_ROWS        4
+
+//Parallel display: D4-D7 on PC0-PC3, RS on PC4, EN on PC5, RW to ground
+#define LCD_RS 4
+#define LCD_EN 5
+
+
+int main(){
+  lcd_t i2c_lcd = lcd_constructor(LCD_I2C_ADDRESS, LCD_ROWS);
+  hd44780_par_t par_lcd = hd44780_par_start(&PORTC, LCD_RS, LCD_NO_RW, LCD_EN, NULL);
+
+  i2c_setup();
+  sei();
+  i2c_open();
+
+  //Wait for the power on time of both displays
+  _delay_ms(50);
+  lcd_init(&i2c_lcd);
+  for (uint16_t t = HD44780_PAR_POWER_ON_MS; !hd44780_par_step(&par_lcd, t); t++) {
+    _delay_ms(1);
+  }
+
+  //Same commands on both buses
+  lcd_clear(&i2c_lcd, true);
+  lcd_print_P(&i2c_lcd, PSTR("I2C display"));
+  lcd_move_cursor(&i2c_lcd, 0, 1);
+  lcd_enable_cursor(&i2c_lcd);
+
+  hd44780_send(&par_lcd.hd, LCD_COMMAND, LCD_CLEARDISPLAY);
+  hd44780_par_wait_slow(&par_lcd);
+  hd44780_print_P(&par_lcd.hd, PSTR("Parallel display"));
+  hd44780_move_cursor(&par_lcd.hd, 0, 1);
+  hd44780_display(&par_lcd.hd, LCD_CURSORON, true);
+
+  for(;;);
+
+  i2c_close();
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include "motor.h"
+
+/**
+ * @brief Example of moves generated by the motor module in the
+ * background: one revolution forth and back at increasing rates, while
+ * the main loop stays free (here it just counts how often it runs).
+ * The fast moves accelerate and decelerate, so the motor does not stall,
+ * first with trapezoidal ramps and then with a smoother S-curve.
+ */
+
+
+static uint16_t scurve_table[300];
+
+//Enable on PB4, Step on PB3, Direction on PB2
+static const motor_t motor = MOTOR_PINS(PORTB, 4, PORTB, 3, PORTB, 2);
+
+
+int main(){
+  static const uint16_t rates[] = {200, 800, 3200, 6400};
+  volatile uint32_t loops;
+  motor_scurve_t scurve;
+
+  motor_setup(&motor);
+  sei();
+  motor_enable(&motor);
+  motor_scurve_build(&scurve, scurve_table, 300, 2000, 8000, 160000);
+
+  for(;;) {
+    motor_set_accel(8000);       //steps/s^2, trapezoid
+
+    for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+      motor_move(&motor, MOTOR_STEPS_REV, rates[i]);
+      for (loops = 0; motor_is_busy(); loops++);   //Main loop work goes here
+      _delay_ms(500);
+
+      motor_reverse(&motor);
+      motor_move(&motor, MOTOR_STEPS_REV, rates[i]);
+      while (motor_is_busy());
+      motor_reverse(&motor);
+      _delay_ms(500);
+    }
+
+    //Same acceleration, with the jerk limited to 160000 steps/s^3
+    motor_set_scurve(&scurve);
+    for (uint8_t n = 0; n < 4; n++) {
+      motor_move(&motor, 4 * MOTOR_STEPS_REV, 2000);
+      while (motor_is_busy());
+      motor_reverse(&motor);
+      _delay_ms(500);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include "motor.h"
+
+/**
+ * @brief Example of coordinated moves of an XY gantry: both motors are
+ * stepped by the same interrupt along straight lines (a square and its
+ * diagonals), accelerating and decelerating together.
+ */
+
+
+//X: Enable on PB4, Step on PB3, Direction on PB2
+//Y: Enable on PD7, Step on PD6, Direction on PD5
+static const motor_t x = MOTOR_PINS(PORTB, 4, PORTB, 3, PORTB, 2);
+static const motor_t y = MOTOR_PINS(PORTD, 7, PORTD, 6, PORTD, 5);
+
+
+int main(){
+  static const motor_t *const xy[] = {&x, &y};
+  static const int16_t path[][2] = {
+    {1600, 0}, {0, 1600}, {-1600, 0}, {0, -1600},   //square
+    {1600, 1600}, {-1600, 0}, {1600, -1600}, {-1600, 0},  //diagonals
+    {400, 1200}, {-400, -1200}                      //a steep line and back
+  };
+
+  motor_setup(&x);
+  motor_setup(&y);
+  sei();
+  motor_enable(&x);
+  motor_enable(&y);
+  motor_set_accel(8000);       //steps/s^2 of the dominant axis
+
+  for(;;) {
+    for (uint8_t i = 0; i < sizeof(path) / sizeof(path[0]); i++) {
+      motor_line(xy, path[i], 2, 3200);
+      while (motor_is_busy());   //Main loop work goes here
+      _delay_ms(250);
+    }
+    _delay_ms(1000);
+  }
+
+  return 0;
+}